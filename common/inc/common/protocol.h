@@ -97,11 +97,45 @@
  * value: timeout
  *
  * response format [RC][ID]
+ *
+ * Where:
+ *   - prescaler - number of carrier periods per sample
+ *   - timeout   - number of samples taken while waiting for the start edge, one sample
+ *                 every PROTO_TRANSFER_EDGE_PRESCALER carrier periods
+ *
+ * In stream mode (RX only) the sampler does not stop when the data buffer is full. The buffer is
+ * split into two halves which are filled alternately until PROTO_CMD_TRANSFER_STOP is received.
+ *
+ * In RLE mode (RX only, not combined with stream mode) the data buffer holds one byte per run of
+ * equal samples: [1b - level][7b - run length]. Runs longer than 127 samples are split into several
+ * entries of the same level. Transfer finishes when the data buffer is full and samplesCount reports
+ * the number of bytes written. Buffer use depends on the number of runs only, so RLE captures are
+ * best sampled with the minimal prescaler (PROTO_TRANSFER_EDGE_PRESCALER).
+ *
+ * In edge timing mode (firmware 0.8+, RX only, not combined with other modes) the sampler converts
+ * the signal as fast as possible and records one byte per run of equal samples in RLE entry format,
+ * but with run length in carrier periods measured between edges. Prescaler and start on edge are
+ * ignored, runs longer than 127 carrier periods are split. The run before the first edge is not
+ * recorded, timeout limits the wait for the first edge. Transfer finishes when the data buffer is
+ * full and samplesCount reports the number of bytes written.
+ *
+ * With length flag (firmware 0.7+, RX only, not combined with stream mode) the value is
+ * [8b - length][8b - timeout / 256], where length is the number of data buffer bytes filled by the
+ * capture. Zero length or a length exceeding the buffer selects the whole buffer.
  */
+#define PROTO_TRANSFER_EDGE_PRESCALER 4
+
 #define PROTO_TRANSFER_FLAG_FIRST_ON_START 0x8000
 #define PROTO_TRANSFER_FLAG_START_ON_EDGE  0x4000
 #define PROTO_TRANSFER_FLAG_FALLING_EDGE   0x2000
 #define PROTO_TRANSFER_FLAG_TX_MODE        0x1000
+#define PROTO_TRANSFER_FLAG_STREAM         0x0800
+#define PROTO_TRANSFER_FLAG_RLE            0x0400
+#define PROTO_TRANSFER_FLAG_LENGTH         0x0200
+#define PROTO_TRANSFER_FLAG_EDGE_TIMING    0x0100
+
+#define PROTO_RLE_LEVEL_MASK  0x80
+#define PROTO_RLE_LENGTH_MASK 0x7f
 
 #define PROTO_CMD_TRANSFER_START      0x09
 
@@ -110,6 +144,8 @@
  * value: ignored
  *
  * response format [1B - RC][1B - STATUS][2B - samplesCount]
+ *
+ * In stream mode samplesCount holds the number of completed buffer halves (modulo 2^16).
  */
 
 #define PROTO_TRANSFER_STATUS_UNKNOWN     0x00
@@ -119,4 +155,46 @@
 
 #define PROTO_CMD_TRANSFER_STATUS     0x0a
 
+/*
+ * Stops running transfer
+ *  index: [ID]
+ *  value: ignored
+ *
+ * response format [RC]
+ */
+#define PROTO_CMD_TRANSFER_STOP       0x0b
+
+/*
+ * Reads one half of the data buffer in stream mode
+ *  index: half sequence number
+ *  value: ignored
+ *
+ * Half (sequence & 1) of the data buffer is returned. Sequence N is valid when it was completed
+ * (samplesCount > N) and is still valid after the read if samplesCount <= N + 1.
+ */
+#define PROTO_CMD_STREAM_READ         0x0c
+
+/*
+ * Reads captured part of the data buffer, allowed while the transfer is running (firmware 0.6+)
+ *  index: offset in bytes
+ *  value: maximal length in bytes
+ *
+ * Response is cut at the end of captured data, which is byte (samplesCount / 8) in bitmap mode and
+ * byte samplesCount in RLE and edge timing mode. Response is empty in stream and TX mode.
+ */
+#define PROTO_CMD_SAMPLE_RANGE_READ   0x0d
+
+/*
+ * Transfer completion record (firmware 0.5+)
+ *
+ * Posted on the interrupt-in endpoint when a transfer finishes.
+ *
+ * record format [1B - ID][1B - STATUS][2B - samplesCount]
+ *
+ * Fields are the same as in the PROTO_CMD_TRANSFER_STATUS response. Only the record of the last
+ * finished transfer is kept, a record which was not collected is replaced by the next one.
+ */
+#define PROTO_COMPLETION_ENDPOINT    0x81
+#define PROTO_COMPLETION_RECORD_SIZE 4
+
 #endif /* COMMON_INC_COMMON_PROTOCOL_H_ */
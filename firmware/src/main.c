@@ -16,7 +16,7 @@
  */
 
 #define FIRMWARE_VERSION_MAJOR 0
-#define FIRMWARE_VERSION_MINOR 1
+#define FIRMWARE_VERSION_MINOR 8
 
 #include <avr/io.h>
 #include <avr/pgmspace.h>
@@ -32,7 +32,7 @@
 
 /*
  * Timer configuration
- * - Timer0 - transmitter/receiver prescaler
+ * - Timer0 - transmitter/receiver prescaler, counts carrier periods in edge timing mode
  * - Timer1 - coil timebase generator (125kHz)
  */
 
@@ -51,7 +51,7 @@
 #define PULSE_VECTOR_SIZE      7
 #define SAMPLE_BUFFER_SIZE   192
 
-#define PRESCALER_MINIMAL_VALUE 4
+#define PRESCALER_MINIMAL_VALUE PROTO_TRANSFER_EDGE_PRESCALER
 
 #define ADC_REF_MV ((uint16_t)4750)
 #define ADC_HI_MV  ((uint16_t) 100)
@@ -83,7 +83,11 @@ typedef struct _CommonContext {
 	uint8_t  prescalerCompOnStart : 1;
 	uint8_t  edgeStart            : 1;
 	uint8_t  tx                   : 1;
+	uint8_t  stream               : 1;
+	uint8_t  rle                  : 1;
+	uint8_t  edgeTiming           : 1;
 	uint8_t  prescalerValue;
+	uint8_t  length;
 	uint8_t  id;
 } CommonContext;
 
@@ -105,6 +109,21 @@ static volatile uint8_t ioBufferOffset = 0;
 static volatile uint16_t opLength;
 // Current offset in sample buffer regarding RX/TX operation
 static volatile uint16_t opOffset;
+// Number of buffer halves filled in stream mode
+static volatile uint16_t streamHalves;
+// Buffer half requested by PROTO_CMD_STREAM_READ
+static volatile uint8_t  streamReadHalf;
+// End of the buffer range requested by PROTO_CMD_SAMPLE_RANGE_READ
+static volatile uint8_t  rangeReadEnd;
+
+// Current run in RLE mode
+static volatile uint8_t rleLevel;
+static volatile uint8_t rleLength;
+
+// Timer0 value at the last edge in edge timing mode
+static volatile uint8_t edgeLast;
+// First edge was seen, the run before it is incomplete
+static volatile uint8_t edgeStarted;
 
 // Common context
 static volatile CommonContext _commonCtx = {
@@ -115,7 +134,11 @@ static volatile CommonContext _commonCtx = {
 	.prescalerCompOnStart = 0,
 	.edgeStart            = 0,
 	.tx                   = 0,
+	.stream               = 0,
+	.rle                  = 0,
+	.edgeTiming           = 0,
 	.prescalerValue       = PRESCALER_MINIMAL_VALUE,
+	.length               = 0,
 	.id                   = 0
 };
 
@@ -174,7 +197,7 @@ ISR(TIMER0_COMPA_vect) {
 
 // This interrupt is used by sampler
 ISR(ADC_vect) {
-	uint8_t oldSignal = adcLastSignal;
+	int8_t oldSignal = adcLastSignal;
 
 	// Clear interrupt flag on prescaler timer
 	TIFR |= _BV(OCF0A);
@@ -189,6 +212,67 @@ ISR(ADC_vect) {
 	}
 
 	do {
+		// Timeout runs before the first edge even while the signal level is unknown
+		if (_commonCtx.edgeTiming) {
+			uint8_t now     = TCNT0;
+			uint8_t elapsed = now - edgeLast;
+
+			// Conversions finished after the end of the capture
+			if (_commonCtx.state != STATE_RX) {
+				break;
+			}
+
+			if ((oldSignal != -1) && (adcLastSignal != oldSignal)) {
+				if (edgeStarted) {
+					if (elapsed > PROTO_RLE_LENGTH_MASK) {
+						elapsed = PROTO_RLE_LENGTH_MASK;
+					}
+
+					ioBuffer[opOffset++] = (oldSignal ? PROTO_RLE_LEVEL_MASK : 0) | elapsed;
+				}
+
+				edgeLast    = now;
+				edgeStarted = 1;
+
+			} else if (edgeStarted) {
+				if (elapsed >= PROTO_RLE_LENGTH_MASK) {
+					// Long run is split before the counter wraps
+					ioBuffer[opOffset++] = (oldSignal ? PROTO_RLE_LEVEL_MASK : 0) | PROTO_RLE_LENGTH_MASK;
+
+					edgeLast += PROTO_RLE_LENGTH_MASK;
+				}
+
+			} else {
+				// Timeout counts PROTO_TRANSFER_EDGE_PRESCALER carrier periods while waiting for the first edge
+				uint8_t ticks = elapsed / PROTO_TRANSFER_EDGE_PRESCALER;
+
+				if (ticks) {
+					edgeLast += ticks * PROTO_TRANSFER_EDGE_PRESCALER;
+
+					if (_commonCtx.timeout > ticks) {
+						_commonCtx.timeout -= ticks;
+
+					} else {
+						_prescallerStop();
+						_adcStop();
+
+						_commonCtx.state    = STATE_FINISHED;
+						_commonCtx.timedOut = 1;
+						break;
+					}
+				}
+			}
+
+			if (opOffset == opLength) {
+				_prescallerStop();
+				_adcStop();
+
+				_commonCtx.state = STATE_FINISHED;
+			}
+
+			break;
+		}
+
 		// return if last sample was unknown
 		if (oldSignal == -1) {
 			break;
@@ -234,6 +318,28 @@ ISR(ADC_vect) {
 			break;
 		}
 
+		if (_commonCtx.rle) {
+			if ((adcLastSignal == rleLevel) && (rleLength < PROTO_RLE_LENGTH_MASK)) {
+				rleLength++;
+
+			} else {
+				if (rleLength) {
+					ioBuffer[opOffset++] = (rleLevel ? PROTO_RLE_LEVEL_MASK : 0) | rleLength;
+				}
+
+				rleLevel  = adcLastSignal;
+				rleLength = 1;
+
+				if (opOffset == opLength) {
+					_prescallerStop();
+
+					_commonCtx.state = STATE_FINISHED;
+				}
+			}
+
+			break;
+		}
+
 		if (adcLastSignal) {
 			ioBuffer[opOffset / 8] |= (1 << (opOffset % 8));
 
@@ -242,9 +348,18 @@ ISR(ADC_vect) {
 		}
 
 		if (++opOffset == opLength) {
-			_prescallerStop();
+			if (_commonCtx.stream) {
+				opOffset = 0;
+				streamHalves++;
 
-			_commonCtx.state = STATE_FINISHED;
+			} else {
+				_prescallerStop();
+
+				_commonCtx.state = STATE_FINISHED;
+			}
+
+		} else if (_commonCtx.stream && (opOffset == (opLength >> 1))) {
+			streamHalves++;
 		}
 	} while (0);
 
@@ -359,6 +474,16 @@ static uchar usbFunctionRead(uchar *data, uchar len) {
 			src     = ioBuffer;
 			srcSize = SAMPLE_BUFFER_SIZE;
 			break;
+
+		case PROTO_CMD_STREAM_READ:
+			src     = ioBuffer + (streamReadHalf ? (SAMPLE_BUFFER_SIZE / 2) : 0);
+			srcSize = SAMPLE_BUFFER_SIZE / 2;
+			break;
+
+		case PROTO_CMD_SAMPLE_RANGE_READ:
+			src     = ioBuffer;
+			srcSize = rangeReadEnd;
+			break;
 	}
 
 	if (src != NULL) {
@@ -455,9 +580,20 @@ static usbMsgLen_t usbFunctionSetup(uint8_t data[8]) {
 				_commonCtx.fallingEdge          = (rq->wIndex.word & PROTO_TRANSFER_FLAG_FALLING_EDGE)   != 0;
 				_commonCtx.tx                   = (rq->wIndex.word & PROTO_TRANSFER_FLAG_TX_MODE)        != 0;
 				_commonCtx.edgeStart            = (rq->wIndex.word & PROTO_TRANSFER_FLAG_START_ON_EDGE)  != 0;
+				_commonCtx.stream               = (rq->wIndex.word & PROTO_TRANSFER_FLAG_STREAM)         != 0;
+				_commonCtx.rle                  = (rq->wIndex.word & PROTO_TRANSFER_FLAG_RLE)            != 0;
+				_commonCtx.edgeTiming           = (rq->wIndex.word & PROTO_TRANSFER_FLAG_EDGE_TIMING)    != 0;
+
+				if (rq->wIndex.word & PROTO_TRANSFER_FLAG_LENGTH) {
+					_commonCtx.length  = rq->wValue.bytes[1];
+					_commonCtx.timeout = (uint16_t) rq->wValue.bytes[0] << 8;
+
+				} else {
+					_commonCtx.length  = 0;
+					_commonCtx.timeout = rq->wValue.word;
+				}
 
 				_commonCtx.state    = STATE_STARTING;
-				_commonCtx.timeout  = rq->wValue.word;
 				_commonCtx.timedOut = 0;
 
 				response[ret++] = PROTO_RC_OK;
@@ -488,12 +624,81 @@ static usbMsgLen_t usbFunctionSetup(uint8_t data[8]) {
 						response[ret++] = PROTO_TRANSFER_STATUS_IN_PROGRESS;
 					}
 
-					response[ret++] = opOffset >> 8;
-					response[ret++] = opOffset & 0xff;
+					if (_commonCtx.stream) {
+						response[ret++] = streamHalves >> 8;
+						response[ret++] = streamHalves & 0xff;
+
+					} else {
+						response[ret++] = opOffset >> 8;
+						response[ret++] = opOffset & 0xff;
+					}
 				}
 			}
 			break;
 
+		case PROTO_CMD_TRANSFER_STOP:
+			{
+				if (rq->wIndex.word != _commonCtx.id) {
+					response[ret++] = PROTO_RC_INVALID_VAL;
+
+				} else {
+					uint8_t sreg = SREG;
+
+					cli();
+
+					if ((_commonCtx.state == STATE_RX) || (_commonCtx.state == STATE_WAIT_CONDITION)) {
+						_prescallerStop();
+
+						_commonCtx.state = STATE_FINISHED;
+					}
+
+					SREG = sreg;
+
+					response[ret++] = PROTO_RC_OK;
+				}
+			}
+			break;
+
+		case PROTO_CMD_STREAM_READ:
+			{
+				ioBufferOffset = 0;
+				streamReadHalf = rq->wIndex.word & 1;
+				command        = rq->bRequest;
+				ret            = 0xff;
+			}
+			break;
+
+		case PROTO_CMD_SAMPLE_RANGE_READ:
+			{
+				uint16_t captured;
+				uint16_t end;
+				uint8_t  sreg = SREG;
+
+				cli();
+				captured = opOffset;
+				SREG = sreg;
+
+				// Only whole bytes of the bitmap are captured
+				if (! _commonCtx.rle && ! _commonCtx.edgeTiming) {
+					captured >>= 3;
+				}
+
+				if (_commonCtx.tx || _commonCtx.stream) {
+					captured = 0;
+				}
+
+				end = captured;
+				if ((rq->wIndex.word < captured) && (rq->wValue.word < captured - rq->wIndex.word)) {
+					end = rq->wIndex.word + rq->wValue.word;
+				}
+
+				rangeReadEnd   = end;
+				ioBufferOffset = rq->wIndex.word < end ? rq->wIndex.word : end;
+				command        = rq->bRequest;
+				ret            = 0xff;
+			}
+			break;
+
 		case PROTO_CMD_PULSE_VECTOR_READ:
 		case PROTO_CMD_PULSE_VECTOR_WRITE:
 		case PROTO_CMD_SAMPLE_VECTOR_READ:
@@ -574,6 +779,116 @@ static void _calibrateOscillator(void) {
 	OSCCAL = optimumValue;
 }
 
+
+// Posts completion record of the finished transfer on the interrupt-in endpoint
+static void _postCompletion(void) {
+	uint8_t  record[PROTO_COMPLETION_RECORD_SIZE];
+	uint16_t count = _commonCtx.stream ? streamHalves : opOffset;
+
+	record[0] = _commonCtx.id;
+	record[1] = _commonCtx.timedOut ? PROTO_TRANSFER_STATUS_TIMEOUT : PROTO_TRANSFER_STATUS_OK;
+	record[2] = count >> 8;
+	record[3] = count & 0xff;
+
+	// Record of previous transfer which was not collected by the host is replaced
+	usbSetInterrupt(record, sizeof(record));
+}
+
+
+// Transfer is started right after its request and stopped as soon as it finishes
+static void _handleStateChange(void) {
+	switch (_commonCtx.state) {
+		case STATE_STARTING:
+			{
+				// Transfer buffer
+				opOffset     = 0;
+				opLength     = (uint16_t) SAMPLE_BUFFER_SIZE;
+				streamHalves = 0;
+
+				// Capture fills only the requested part of the buffer
+				if (! _commonCtx.tx && ! _commonCtx.stream && _commonCtx.length && (_commonCtx.length < SAMPLE_BUFFER_SIZE)) {
+					opLength = _commonCtx.length;
+				}
+
+				if (_commonCtx.tx) {
+					opLength *= 2;
+
+					_commonCtx.edgeTiming = 0;
+
+				} else if (_commonCtx.edgeTiming) {
+					_commonCtx.stream    = 0;
+					_commonCtx.edgeStart = 0;
+
+					edgeLast    = 0;
+					edgeStarted = 0;
+
+				} else if (_commonCtx.rle) {
+					_commonCtx.stream = 0;
+
+					rleLevel  = 0;
+					rleLength = 0;
+
+				} else {
+					opLength *= 8;
+				}
+
+				// ADC synchronization flag
+				adcLastSignal = -1;
+
+				// ADC runs free in edge timing mode, otherwise it is triggered by the prescaler
+				if (_commonCtx.edgeTiming) {
+					ADCSRB &= ~(_BV(ADTS0) | _BV(ADTS1));
+
+				} else {
+					ADCSRB |= (_BV(ADTS0) | _BV(ADTS1));
+				}
+
+				// Change state
+				if (_commonCtx.edgeStart) {
+					_commonCtx.state = STATE_WAIT_CONDITION;
+
+				} else {
+					if (_commonCtx.tx) {
+						_commonCtx.state = STATE_TX;
+
+					} else {
+						_commonCtx.state = STATE_RX;
+					}
+				}
+
+				sei();
+
+				_adcStart();
+				if (_commonCtx.state == STATE_WAIT_CONDITION) {
+					_prescallerStart(0, PRESCALER_MINIMAL_VALUE, 0);
+				} else if (_commonCtx.edgeTiming) {
+					// Counter wraps after 256 carrier periods
+					_prescallerStart(0, 0, 0);
+				} else {
+					_prescallerStart(_commonCtx.tx, _commonCtx.prescalerValue, 1);
+				}
+			}
+			break;
+
+		case STATE_FINISHED:
+			{
+				cli();
+
+				_prescallerStop();
+				_adcStop();
+
+				_commonCtx.state = STATE_IDLE;
+
+				_postCompletion();
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+
 void USB_INTR_VECTOR(void);
 
 __attribute__((OS_main)) main(void) {
@@ -612,7 +927,7 @@ __attribute__((OS_main)) main(void) {
 		wdt_reset();
 
 		if (! fastctr) {
-			// commands are only evaluated after next USB transmission or after 5 ms passed
+			// Reset is evaluated only after 5 ms of USB inactivity, the host has to receive the response first
 			switch (command) {
 				case PROTO_CMD_RESET:
 					{
@@ -630,65 +945,11 @@ __attribute__((OS_main)) main(void) {
 				default:
 					break;
 			}
-
-			// Handle transfer state change
-			switch (_commonCtx.state) {
-				case STATE_STARTING:
-					{
-						// Transfer buffer
-						opOffset = 0;
-						opLength = (uint16_t) SAMPLE_BUFFER_SIZE;
-
-						if (_commonCtx.tx) {
-							opLength *= 2;
-
-						} else {
-							opLength *= 8;
-						}
-
-						// ADC synchronization flag
-						adcLastSignal = -1;
-
-						// Change state
-						if (_commonCtx.edgeStart) {
-							_commonCtx.state = STATE_WAIT_CONDITION;
-
-						} else {
-							if (_commonCtx.tx) {
-								_commonCtx.state = STATE_TX;
-
-							} else {
-								_commonCtx.state = STATE_RX;
-							}
-						}
-
-						sei();
-
-						_adcStart();
-						if (_commonCtx.state == STATE_WAIT_CONDITION) {
-							_prescallerStart(0, PRESCALER_MINIMAL_VALUE, 0);
-						} else {
-							_prescallerStart(_commonCtx.tx, _commonCtx.prescalerValue, 1);
-						}
-					}
-					break;
-
-				case STATE_FINISHED:
-					{
-						cli();
-
-						_prescallerStop();
-						_adcStop();
-
-						_commonCtx.state = STATE_IDLE;
-					}
-					break;
-
-				default:
-					break;
-			}
 		}
 
+		// Finished transfer becomes idle before a pending status request is answered
+		_handleStateChange();
+
 		{
 			// This is usbpoll() minus reset logic and double buffering
 			int8_t  len = usbRxLen - 3;
@@ -696,6 +957,9 @@ __attribute__((OS_main)) main(void) {
 			if (len >= 0){
 				usbProcessRx(usbRxBuf + 1, len); // only single buffer due to in-order processing
 				usbRxLen = 0;                    // mark rx buffer as available
+
+				// Requested transfer starts without waiting for USB inactivity
+				_handleStateChange();
 			}
 
 			if(usbTxLen & 0x10) {             // transmit system idle
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmark of the sampler bitmap to samples conversion. Every kernel is compared with the
+ * bit by bit reference first, then timed over the same set of synthetic captures.
+ */
+
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "rfid/BitmapDecoder.hpp"
+
+#define CAPTURE_SIZE  192
+#define CAPTURES     4096
+#define ROUNDS        100
+#define PRESCALER       8
+
+using Sample = rfid::device::Interface::Sample;
+
+
+static void _decodeReference(const std::vector<uint8_t> &buffer, std::vector<Sample> &samples) {
+	int level  = -1;
+	int length = 0;
+
+	for (size_t i = 0; i < buffer.size(); i++) {
+		for (int j = 0; j < 8; j++) {
+			int bit = (buffer[i] >> j) & 1;
+
+			if (bit != level) {
+				if (level != -1) {
+					samples.push_back(Sample::fromCarriers(length * PRESCALER, ! level));
+				}
+
+				level  = bit;
+				length = 0;
+			}
+
+			length++;
+		}
+	}
+}
+
+
+// Signal with runs of 1 - maxRun samples, like a token at various data rates
+static std::vector<uint8_t> _generate(unsigned maxRun) {
+	std::vector<uint8_t> ret(CAPTURE_SIZE, 0);
+
+	unsigned bit   = 0;
+	int      level = rand() & 1;
+
+	while (bit < CAPTURE_SIZE * 8) {
+		unsigned run = 1 + rand() % maxRun;
+
+		for (unsigned i = 0; (i < run) && (bit < CAPTURE_SIZE * 8); i++, bit++) {
+			if (level) {
+				ret[bit / 8] |= 1 << (bit % 8);
+			}
+		}
+
+		level = ! level;
+	}
+
+	return ret;
+}
+
+
+static bool _same(const std::vector<Sample> &a, const std::vector<Sample> &b) {
+	if (a.size() != b.size()) {
+		return false;
+	}
+
+	for (size_t i = 0; i < a.size(); i++) {
+		if ((a[i].getLengthCarriers() != b[i].getLengthCarriers()) || (a[i].isLow() != b[i].isLow())) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+static void _bench(const char *name, const std::vector<std::vector<uint8_t>> &captures, const std::function<void(const std::vector<uint8_t> &, std::vector<Sample> &)> &decode) {
+	std::vector<Sample> samples;
+	size_t              total = 0;
+
+	samples.reserve(CAPTURE_SIZE * 8);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int round = 0; round < ROUNDS; round++) {
+		for (const auto &capture : captures) {
+			samples.clear();
+
+			decode(capture, samples);
+
+			total += samples.size();
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double mbytes  = (double) CAPTURE_SIZE * captures.size() * ROUNDS / (1024 * 1024);
+
+	printf("%-10s %8.1f MB/s  %8.2f Msamples/s  %6.1f ns/capture\n", name, mbytes / seconds, total / seconds / 1e6, seconds * 1e9 / (captures.size() * ROUNDS));
+}
+
+
+int main() {
+	std::vector<std::vector<uint8_t>> captures;
+
+	for (int i = 0; i < CAPTURES; i++) {
+		captures.push_back(_generate(1 + i % 16));
+	}
+
+	// Correctness, decoder state is also checked by splitting captures at odd offsets
+	for (auto kernel : { rfid::device::BitmapDecoder::KERNEL_WORD, rfid::device::BitmapDecoder::KERNEL_AVX2 }) {
+		for (const auto &capture : captures) {
+			std::vector<Sample> expected;
+			std::vector<Sample> whole;
+			std::vector<Sample> split;
+
+			_decodeReference(capture, expected);
+
+			{
+				rfid::device::BitmapDecoder decoder(PRESCALER);
+
+				decoder.setKernel(kernel);
+				decoder.decode(capture.data(), capture.size(), whole);
+			}
+
+			{
+				rfid::device::BitmapDecoder decoder(PRESCALER);
+
+				size_t split1 = 1 + rand() % (capture.size() - 2);
+
+				decoder.setKernel(kernel);
+				decoder.decode(capture.data(), split1, split);
+				decoder.decode(capture.data() + split1, capture.size() - split1, split);
+			}
+
+			if (! _same(expected, whole) || ! _same(expected, split)) {
+				printf("Kernel %d output differs from the reference!\n", kernel);
+
+				return 1;
+			}
+		}
+	}
+
+	printf("AVX2 %s\n", rfid::device::BitmapDecoder::getBestKernel() == rfid::device::BitmapDecoder::KERNEL_AVX2 ? "available" : "not available");
+
+	_bench("reference", captures, [](const std::vector<uint8_t> &capture, std::vector<Sample> &samples) {
+		_decodeReference(capture, samples);
+	});
+
+	for (auto kernel : { rfid::device::BitmapDecoder::KERNEL_WORD, rfid::device::BitmapDecoder::KERNEL_AVX2 }) {
+		rfid::device::BitmapDecoder decoder(PRESCALER);
+
+		decoder.setKernel(kernel);
+
+		_bench(kernel == rfid::device::BitmapDecoder::KERNEL_WORD ? "word" : "avx2", captures, [&decoder](const std::vector<uint8_t> &capture, std::vector<Sample> &samples) {
+			decoder.reset();
+			decoder.decode(capture.data(), capture.size(), samples);
+		});
+	}
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmark of the decoder chain. Listener based chain, statically chained pipeline and the
+ * decoder bank are fed with the same synthetic EM4100 capture and have to find the same tokens.
+ */
+
+#include <chrono>
+#include <functional>
+#include <cstdlib>
+#include <cstdio>
+#include <vector>
+
+#include "common/Log.hpp"
+#include "rfid/CarrierDecoder.hpp"
+#include "rfid/DecoderBank.hpp"
+#include "rfid/Em4100Decoder.hpp"
+#include "rfid/Em4100Eprom.hpp"
+#include "rfid/Pipeline.hpp"
+#include "rfid/impl/ManchesterDecoder.hpp"
+
+#define FRAMES          4096
+#define ROUNDS            20
+#define CARRIER_DIVIDER   32
+
+using Sample = rfid::device::Interface::Sample;
+
+
+class TokenCounter : public common::Listener {
+	public:
+		size_t tokens;
+
+		TokenCounter() : tokens(0) {
+		}
+
+		void onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+			this->tokens++;
+		}
+};
+
+
+// Manchester coded frames with +-1 carrier jitter
+static std::vector<Sample> _generate() {
+	std::vector<Sample> ret;
+	std::vector<bool>   halves;
+	uint32_t            eprom[2] = { 0, 0 };
+
+	rfid::Em4100Eprom::generate(eprom, 0x4b, 0x166b24);
+
+	for (int frame = 0; frame < FRAMES; frame++) {
+		for (int i = 0; i < 64; i++) {
+			bool bit = (eprom[i / 32] >> (i % 32)) & 1;
+
+			halves.push_back(bit);
+			halves.push_back(! bit);
+		}
+	}
+
+	for (size_t i = 0; i < halves.size(); ) {
+		size_t j = i;
+
+		while ((j < halves.size()) && (halves[j] == halves[i])) {
+			j++;
+		}
+
+		ret.push_back(Sample::fromCarriers((j - i) * CARRIER_DIVIDER / 2 + rand() % 3 - 1, halves[i]));
+
+		i = j;
+	}
+
+	return ret;
+}
+
+
+static size_t _bench(const char *name, const std::vector<Sample> &samples, const std::function<size_t()> &decode) {
+	size_t tokens = 0;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int round = 0; round < ROUNDS; round++) {
+		tokens = decode();
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%-10s %8.2f Msamples/s  %6.1f ns/sample  %zu tokens\n", name, samples.size() * ROUNDS / seconds / 1e6, seconds * 1e9 / (samples.size() * ROUNDS), tokens);
+
+	return tokens;
+}
+
+
+int main() {
+	std::vector<Sample> samples = _generate();
+
+	size_t tokensListener;
+	size_t tokensPipeline;
+	size_t tokensBank;
+
+	common::Log::setLevel(common::Log::NONE);
+
+	tokensListener = _bench("listener", samples, [&samples]() {
+		rfid::CarrierDecoder    carrierDecoder(CARRIER_DIVIDER);
+		rfid::ManchesterDecoder manchesterDecoder(&carrierDecoder);
+		rfid::Em4100Decoder     em4100Decoder(&manchesterDecoder);
+		TokenCounter            counter;
+
+		em4100Decoder.addListener(&counter);
+		carrierDecoder.checkPulses(samples);
+
+		return counter.tokens;
+	});
+
+	tokensPipeline = _bench("pipeline", samples, [&samples]() {
+		rfid::ManchesterPipeline pipeline(CARRIER_DIVIDER);
+		TokenCounter             counter;
+
+		pipeline.addListener(&counter);
+		pipeline.checkPulses(samples);
+
+		return counter.tokens;
+	});
+
+	tokensBank = _bench("bank", samples, [&samples]() {
+		rfid::DecoderBank bank;
+		TokenCounter      counter;
+
+		bank.addListener(&counter);
+		bank.checkPulses(samples);
+
+		return counter.tokens;
+	});
+
+	if ((tokensListener != tokensPipeline) || (tokensListener != tokensBank)) {
+		printf("Decoders found different number of tokens!\n");
+
+		return 1;
+	}
+
+	return 0;
+}
@@ -29,21 +29,21 @@ namespace common {
 			};
 
 		public:
-			static void debug(const std::string &format, ...);
-			static void log(const std::string &format, ...);
-			static void warn(const std::string &format, ...);
-			static void error(const std::string &format, ...);
+			static void debug(const char *format, ...);
+			static void log(const char *format, ...);
+			static void warn(const char *format, ...);
+			static void error(const char *format, ...);
 
-			static void reportStdOut(const std::string &format, ...);
-			static void reportStdErr(const std::string &format, ...);
+			static void reportStdOut(const char *format, ...);
+			static void reportStdErr(const char *format, ...);
 
 			static void dump(void *buffer, size_t bufferSize, size_t lineLength = 32);
 
 			static void setLevel(Level level);
 
 		protected:
-			static void report(Level level, const std::string &format, ...);
-			static void report(Level level, const std::string &format, va_list &list);
+			static void report(Level level, const char *format, ...);
+			static void report(Level level, const char *format, va_list &list);
 
 		private:
 			static Level _level;
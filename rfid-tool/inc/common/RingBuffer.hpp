@@ -0,0 +1,106 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_RINGBUFFER_HPP_
+#define COMMON_RINGBUFFER_HPP_
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+namespace common {
+	/*
+	 * Lock-free ring buffer for exactly one producer and one consumer thread.
+	 */
+	template <typename T>
+	class RingBuffer {
+		private:
+			std::vector<T> buffer;
+
+			std::atomic<size_t> head; // next slot to write, owned by producer
+			std::atomic<size_t> tail; // next slot to read, owned by consumer
+
+		private:
+			RingBuffer(const RingBuffer &other) = delete;
+			RingBuffer &operator=(const RingBuffer &other) = delete;
+
+			size_t next(size_t idx) const {
+				return (idx + 1 == this->buffer.size()) ? 0 : idx + 1;
+			}
+
+		public:
+			RingBuffer(size_t capacity) : buffer(capacity + 1), head(0), tail(0) {
+			}
+
+			virtual ~RingBuffer() {
+			}
+
+			bool push(const T &item) {
+				size_t h  = this->head.load(std::memory_order_relaxed);
+				size_t nh = this->next(h);
+
+				if (nh == this->tail.load(std::memory_order_acquire)) {
+					return false;
+				}
+
+				this->buffer[h] = item;
+				this->head.store(nh, std::memory_order_release);
+
+				return true;
+			}
+
+			bool pop(T &item) {
+				size_t t = this->tail.load(std::memory_order_relaxed);
+
+				if (t == this->head.load(std::memory_order_acquire)) {
+					return false;
+				}
+
+				item = this->buffer[t];
+				this->tail.store(this->next(t), std::memory_order_release);
+
+				return true;
+			}
+
+			size_t pop(std::vector<T> &items, size_t maxItems) {
+				size_t ret = 0;
+				size_t t   = this->tail.load(std::memory_order_relaxed);
+				size_t h   = this->head.load(std::memory_order_acquire);
+
+				while ((t != h) && (ret < maxItems)) {
+					items.push_back(this->buffer[t]);
+
+					t = this->next(t);
+					ret++;
+				}
+
+				this->tail.store(t, std::memory_order_release);
+
+				return ret;
+			}
+
+			bool isEmpty() const {
+				return this->tail.load(std::memory_order_acquire) == this->head.load(std::memory_order_acquire);
+			}
+
+			size_t getCapacity() const {
+				return this->buffer.size() - 1;
+			}
+	};
+}
+
+#endif /* COMMON_RINGBUFFER_HPP_ */
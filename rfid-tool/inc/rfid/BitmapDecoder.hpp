@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_BITMAPDECODER_HPP_
+#define RFID_BITMAPDECODER_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "rfid/Interface.hpp"
+
+namespace rfid {
+	namespace device {
+		/*
+		 * Converts sampler bitmap (one bit per sample, LSB first) into samples. Transitions are
+		 * found 64 bits at a time and counted 256 bits at a time when the CPU supports AVX2. State
+		 * is kept between calls, so consecutive buffers are decoded as one signal.
+		 */
+		class BitmapDecoder {
+			public:
+				enum Kernel {
+					KERNEL_WORD,
+					KERNEL_AVX2
+				};
+
+			public:
+				BitmapDecoder(uint16_t prescaler);
+
+				void reset();
+
+				// Best kernel supported by the CPU, selected by default
+				static Kernel getBestKernel();
+				void setKernel(Kernel kernel);
+
+				/*
+				 * Stores up to samplesCapacity samples and returns the number of samples found in
+				 * the buffer, which may be greater than the capacity.
+				 */
+				size_t decode(const uint8_t *buffer, size_t bufferSize, Interface::Sample *samples, size_t samplesCapacity);
+
+				// Appends samples to the vector, which is grown at most once per call
+				void decode(const uint8_t *buffer, size_t bufferSize, std::vector<Interface::Sample> &samples);
+
+			private:
+				size_t countTransitions(const uint8_t *buffer, size_t bufferSize) const;
+
+			private:
+				uint16_t prescaler;
+				Kernel   kernel;
+
+				// Level of the last decoded sample, -1 before the first one
+				int      level;
+				// Length of the pending run in samples
+				uint32_t runLength;
+		};
+	}
+}
+
+#endif /* RFID_BITMAPDECODER_HPP_ */
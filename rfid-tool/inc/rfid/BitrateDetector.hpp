@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_BITRATEDETECTOR_HPP_
+#define RFID_BITRATEDETECTOR_HPP_
+
+#include <cstdint>
+#include <cstddef>
+
+#include "rfid/Interface.hpp"
+
+namespace rfid {
+	/*
+	 * Detects the carrier divider from a pulse length histogram. Short pulses last half of the bit
+	 * period and long pulses a whole bit period for both Manchester and Biphase coding, so the
+	 * divider whose two clusters explain the histogram best is chosen.
+	 */
+	class BitrateDetector {
+		public:
+			// Data rates supported by T5557 (RF/n)
+			static const uint8_t CARRIER_DIVIDERS[8];
+
+			struct Result {
+				uint8_t carrierDivider;
+				// Allowed deviation of pulse length (carrier periods)
+				uint8_t tolerance;
+			};
+
+		private:
+			BitrateDetector() = delete;
+
+		public:
+			// Returns false when the samples do not match any data rate
+			static bool detect(const rfid::device::Interface::Sample *samples, size_t samplesCount, Result &result);
+	};
+}
+
+#endif /* RFID_BITRATEDETECTOR_HPP_ */
@@ -21,7 +21,9 @@
 #include <cstdint>
 
 #include "common/Notifier.hpp"
+#include "common/Log.hpp"
 #include "rfid/Interface.hpp"
+#include "rfid/SampleArray.hpp"
 
 namespace rfid {
 	class CarrierDecoder : public common::Notifier {
@@ -41,12 +43,49 @@ namespace rfid {
 				bool isLong;
 			};
 
+			enum ClockRecovery {
+				// Pulse ranges are centered on nominal period of the divider
+				CLOCK_RECOVERY_NONE,
+				// Pulse ranges follow measured period of drifting tags
+				CLOCK_RECOVERY_PLL
+			};
+
+			// Samples classified at once by the block interface
+			static const size_t CLASSIFY_BLOCK = 64;
+
 		private:
-			// Pulse length range
+			static const uint8_t PULSE_MAX      = 50;
+			static const uint8_t ERROR_TRESHOLD = 10; // 20%
+
+			enum PulseClass {
+				PULSE_INVALID = 0,
+				PULSE_SHORT   = 1,
+				PULSE_LONG    = 2
+			};
+
+			// Forwards decoder events to listeners
+			struct NotifierSink {
+				CarrierDecoder &decoder;
+
+				NotifierSink(CarrierDecoder &decoder) : decoder(decoder) {
+				}
+
+				void onSyncChanged(EventSyncData &data) {
+					this->decoder.notify(EVENT_SYNC_CHANGED, &data);
+				}
+
+				void onPulse(EventPulseData &data) {
+					this->decoder.notify(EVENT_NEW_PULSE, &data);
+				}
+			};
+
+			// Pulse length range (carrier periods)
 			uint16_t longMin;
 			uint16_t longMax;
 			uint16_t shortMin;
 			uint16_t shortMax;
+			// Ranges were changed, pulses classified in advance have to be classified again
+			bool     rangeChanged;
 
 			// Pulses number (0 - 50)
 			uint8_t pulseCount;
@@ -57,15 +96,49 @@ namespace rfid {
 			uint8_t errorCount;
 
 			uint8_t carrierDivider;
+			// Divider is not searched when set, only sync is looked for
+			uint8_t fixedDivider;
+			// Pulse length deviation (carrier periods), 25% of short pulse when 0
+			uint8_t tolerance;
+
+			ClockRecovery clockRecovery;
+			// Tracked half bit period (carrier periods, fixed point)
+			uint32_t      halfPeriod;
 
 			bool    hasSync;
 
 		public:
 			CarrierDecoder();
+			CarrierDecoder(uint8_t fixedDivider);
 			virtual ~CarrierDecoder();
 
 			void reset();
-			void checkPulses(const std::vector<rfid::device::Interface::Sample> &samples);
+			// Locks on divider and tolerance found by BitrateDetector, divider 0 restores hunting
+			void setCarrierDivider(uint8_t carrierDivider, uint8_t tolerance);
+			void setClockRecovery(ClockRecovery clockRecovery);
+			void checkPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount);
+			void checkPulses(const rfid::device::SampleArray &samples);
+
+			void checkPulses(const std::vector<rfid::device::Interface::Sample> &samples) {
+				this->checkPulses(samples.data(), samples.size());
+			}
+
+			// Decodes single sample, events are passed directly to the sink implementing
+			// onSyncChanged(EventSyncData &) and onPulse(EventPulseData &)
+			template <class Sink>
+			void checkPulse(const rfid::device::Interface::Sample &sample, Sink &sink);
+
+			// Block interface, for callers driving several decoders over the same samples. Pulse
+			// classes of a block (up to CLASSIFY_BLOCK samples) are computed at once by
+			// classifyBlock(), checkPulses() decodes samples from start to end of the block and
+			// classifies the rest of it again whenever the pulse ranges change.
+			void classifyBlock(const rfid::device::Interface::Sample *samples, size_t samplesCount, uint8_t *pulseClasses) {
+				this->classifyPulses(samples, samplesCount, pulseClasses);
+				this->rangeChanged = false;
+			}
+
+			template <class Sink>
+			void checkPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t start, size_t end, uint8_t *pulseClasses, Sink &sink);
 
 			uint8_t getCarrierDivider() {
 				return this->carrierDivider;
@@ -73,7 +146,222 @@ namespace rfid {
 
 		private:
 			void updatePulseRange();
+			void resetPeriod();
+			void trackPeriod(uint16_t pulseLength);
+			void nextCarrierDivider();
+
+			// Difference wraps around for pulses below the range, one comparison per range is enough
+			PulseClass classifyPulse(uint16_t pulseLength) const {
+				if ((uint16_t) (pulseLength - this->shortMin) <= (uint16_t) (this->shortMax - this->shortMin)) {
+					return PULSE_SHORT;
+
+				} else if ((uint16_t) (pulseLength - this->longMin) <= (uint16_t) (this->longMax - this->longMin)) {
+					return PULSE_LONG;
+				}
+
+				return PULSE_INVALID;
+			}
+
+			// Classification pass of the block interface. The loop has no branches and is vectorized
+			// by the compiler, ranges are kept in locals because the output could alias them.
+			// Ranges never overlap, so the two bits form a PulseClass value.
+			void classifyPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount, uint8_t *pulseClasses) const {
+				const uint16_t shortMin  = this->shortMin;
+				const uint16_t shortSpan = this->shortMax - this->shortMin;
+				const uint16_t longMin   = this->longMin;
+				const uint16_t longSpan  = this->longMax - this->longMin;
+
+				for (size_t i = 0; i < samplesCount; i++) {
+					uint16_t pulseLength = samples[i].getLengthCarriers();
+
+					pulseClasses[i] = ((uint16_t) (pulseLength - shortMin) <= shortSpan) | (((uint16_t) (pulseLength - longMin) <= longSpan) << 1);
+				}
+			}
+
+			template <class Sink>
+			void checkPulse(const rfid::device::Interface::Sample &sample, PulseClass pulseClass, Sink &sink);
 	};
 }
 
+
+template <class Sink>
+inline void rfid::CarrierDecoder::checkPulse(const rfid::device::Interface::Sample &sample, Sink &sink) {
+	this->checkPulse(sample, this->classifyPulse(sample.getLengthCarriers()), sink);
+}
+
+
+template <class Sink>
+inline void rfid::CarrierDecoder::checkPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t start, size_t end, uint8_t *pulseClasses, Sink &sink) {
+	size_t i = start;
+
+	// Ranges were changed since the block was classified (setCarrierDivider())
+	if (this->rangeChanged) {
+		this->classifyBlock(samples + start, samplesCount - start, pulseClasses + start);
+	}
+
+	while (i < end) {
+		// In sync with fixed ranges valid pulses only count and pass, no error can switch the carrier.
+		// Gaps are never valid, ranges do not start at zero.
+		if (this->hasSync && (this->clockRecovery == CLOCK_RECOVERY_NONE) && (this->errorCount < ERROR_TRESHOLD)) {
+			size_t run = i;
+
+			for (; (i < end) && (pulseClasses[i] != PULSE_INVALID); i++) {
+				EventPulseData data;
+
+				data.isHigh = ! samples[i].isLow();
+				data.isLong = (pulseClasses[i] == PULSE_LONG);
+
+				sink.onPulse(data);
+			}
+
+			// Counters wrap on PULSE_MAX as checkPulse() would leave them
+			if (this->pulseCount + (i - run) >= PULSE_MAX) {
+				this->errorCount = 0;
+			}
+
+			this->pulseCount = (this->pulseCount + (i - run)) % PULSE_MAX;
+
+			if (i == end) {
+				break;
+			}
+		}
+
+		this->checkPulse(samples[i], (PulseClass) pulseClasses[i], sink);
+
+		// Carrier divider or tracked period changed, classify the rest of the block again
+		if (this->rangeChanged) {
+			this->classifyBlock(samples + i + 1, samplesCount - i - 1, pulseClasses + i + 1);
+		}
+
+		i++;
+	}
+}
+
+
+template <class Sink>
+inline void rfid::CarrierDecoder::checkPulse(const rfid::device::Interface::Sample &sample, PulseClass pulseClass, Sink &sink) {
+	bool nextCarrier = false;
+
+	// Signal was lost, look for sync again on the same carrier
+	if (sample.isGap()) {
+		bool hadSync = this->hasSync;
+
+		this->hasSync    = false;
+		this->loCount    = 0;
+		this->hiCount    = 0;
+		this->errorCount = 0;
+		this->pulseCount = 0;
+
+		if (hadSync) {
+			EventSyncData data;
+
+			data.hasSync        = this->hasSync;
+			data.carrierDivider = 0;
+
+			sink.onSyncChanged(data);
+		}
+
+		return;
+	}
+
+	this->pulseCount++;
+
+	// Handle error
+	if (this->errorCount >= ERROR_TRESHOLD) {
+		common::Log::debug("next carrier! error count: %u, loCount: %u, hiCount: %u, pulseCount: %u, divider: %u",
+			this->errorCount, this->loCount, this->hiCount, this->pulseCount, this->carrierDivider
+		);
+
+		nextCarrier = true;
+
+	} else if (this->pulseCount == PULSE_MAX) {
+		// Next loop
+		this->pulseCount = 0;
+		this->errorCount = 0;
+	}
+
+	if (nextCarrier) {
+		this->hasSync    = false;
+		this->loCount    = 0;
+		this->hiCount    = 0;
+		this->errorCount = 0;
+		this->pulseCount = 0;
+
+		{
+			EventSyncData data;
+
+			data.hasSync        = this->hasSync;
+			data.carrierDivider = 0;
+
+			sink.onSyncChanged(data);
+		}
+
+		this->nextCarrierDivider();
+
+	} else {
+		// NO_SYNC -> SYNC
+		if (! this->hasSync) {
+			if (pulseClass == PULSE_SHORT) {
+				this->loCount++;
+
+			} else if (pulseClass == PULSE_LONG) {
+				this->hiCount++;
+
+			} else {
+				//common::Log::debug("Out of sync, bad pulse: %u, (short %u - %u, long %u - %u)",
+				//	sample.getLengthCarriers(), this->shortMin, this->shortMax, this->longMin, this->longMax
+				//);
+
+				this->errorCount++;
+			}
+
+			if (this->hiCount > 4 && this->loCount > 4 && this->errorCount < 4) {
+				this->hasSync = true;
+
+				{
+					EventSyncData data;
+
+					data.hasSync        = this->hasSync;
+					data.carrierDivider = this->carrierDivider;
+
+					sink.onSyncChanged(data);
+				}
+			}
+
+		} else {
+			EventPulseData data;
+
+			data.isHigh = ! sample.isLow();
+
+			if (pulseClass == PULSE_LONG) {
+				data.isLong = true;
+
+				sink.onPulse(data);
+
+			} else if (pulseClass == PULSE_SHORT) {
+				data.isLong = false;
+
+				sink.onPulse(data);
+
+			} else {
+				//common::Log::debug("In sync, bad pulse: %u, (short %u - %u, long %u - %u)",
+				//	sample.getLengthCarriers(), this->shortMin, this->shortMax, this->longMin, this->longMax
+				//);
+
+				this->errorCount++;
+			}
+		}
+
+		if (this->clockRecovery == CLOCK_RECOVERY_PLL) {
+			this->trackPeriod(sample.getLengthCarriers());
+		}
+	}
+
+//		common::Log::debug("sync: %u, divider: %u, short %u - %u, long: %u - %u, errors: %u, pulses: %u, hi: %u, lo: %u",
+//			this->hasSync, this->carrierDivider, this->shortMin, this->shortMax,
+//			this->longMin, this->longMax, this->errorCount, this->pulseCount,
+//			this->hiCount, this->loCount
+//		);
+}
+
 #endif /* RFID_CARRIERDECODER_HPP_ */
@@ -51,6 +51,23 @@ namespace rfid {
 
 			virtual void onEvent(common::Notifier &notifier, const int eventId, void *eventData) = 0;
 
+		protected:
+			// Forwards decoded bits to listeners
+			struct NotifierSink {
+				CodingDecoder &decoder;
+
+				NotifierSink(CodingDecoder &decoder) : decoder(decoder) {
+				}
+
+				void onBit(bool isOne) {
+					EventBitData data;
+
+					data.isOne = isOne;
+
+					this->decoder.notify(EVENT_NEW_BIT, &data);
+				}
+			};
+
 		private:
 			CarrierDecoder *carrierDecoder;
 	};
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_DAEMONPROTOCOL_H_
+#define RFID_DAEMONPROTOCOL_H_
+
+/*
+ * Framing used on the reader daemon unix socket.
+ *
+ * request format  [1B - CMD][2B - payload length][payload]
+ * response format [1B - RC][2B - payload length][payload]
+ *
+ * Multibyte values are big endian. Requests are served in order, one response per request.
+ */
+
+#define DAEMON_HEADER_SIZE  3
+#define DAEMON_PAYLOAD_MAX 64
+
+#define DAEMON_RC_OK            0
+#define DAEMON_RC_INVALID_CMD   1
+#define DAEMON_RC_INVALID_VAL   2
+#define DAEMON_RC_NO_TOKEN      3
+#define DAEMON_RC_DEVICE_ERROR  4
+
+#define DAEMON_MODULATION_MANCHESTER 0
+#define DAEMON_MODULATION_BIPHASE    1
+
+/*
+ * Returns reader state
+ *  payload: none
+ *
+ * response payload [1B - connected][1B - V_MAJ][1B - V_MIN]
+ */
+#define DAEMON_CMD_STATUS 0x01
+
+/*
+ * Reads EM4100 token
+ *  payload: [1B - maximal number of captures]
+ *
+ * response payload [1B - carrier divider][1B - modulation][1B - customer ID][4B - token]
+ */
+#define DAEMON_CMD_READ   0x02
+
+/*
+ * Programs T5557 token as EM4100 token
+ *  payload: [1B - carrier divider][1B - modulation][1B - customer ID][4B - token]
+ *
+ * response payload: none
+ */
+#define DAEMON_CMD_WRITE  0x03
+
+#endif /* RFID_DAEMONPROTOCOL_H_ */
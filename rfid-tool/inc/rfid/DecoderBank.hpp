@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_DECODERBANK_HPP_
+#define RFID_DECODERBANK_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "common/Notifier.hpp"
+#include "rfid/Interface.hpp"
+#include "rfid/CarrierDecoder.hpp"
+#include "rfid/Em4100Decoder.hpp"
+#include "rfid/SoftDecoder.hpp"
+#include "rfid/impl/ManchesterDecoder.hpp"
+#include "rfid/impl/BiphaseDecoder.hpp"
+
+namespace rfid {
+	/*
+	 * Decodes EM4100 frames for every carrier divider and both Manchester and Biphase coding in
+	 * a single pass over the samples. Each hypothesis keeps its own state. The first one producing
+	 * a valid frame wins, afterwards only the winner is fed until a gap or restart().
+	 *
+	 * Successive checkPulses() calls are decoded as one continuous signal, a frame may span
+	 * several of them. Carrier lock, bit phase and partial frames are dropped only on a gap
+	 * sample, which has to be passed whenever samples were lost (restart() does it).
+	 *
+	 * Data rate of every continuous fragment is detected from its pulse histogram first. When it
+	 * is found only the matching hypothesis is fed, all of them otherwise.
+	 *
+	 * Decoders of a hypothesis are chained statically, only tokens are notified to listeners.
+	 * Once a single hypothesis is fed, pulses are classified a block at a time.
+	 *
+	 * With soft decision enabled, samples passed to checkPulses() yielding no token are decoded
+	 * once more by SoftDecoder, which survives single misclassified pulses. The tail of the
+	 * previous call is decoded with them, so frames crossing the boundary are not lost.
+	 */
+	class DecoderBank : public common::Notifier {
+		public:
+			enum Event {
+				EVENT_NEW_TOKEN
+			};
+
+			enum Modulation {
+				MODULATION_MANCHESTER,
+				MODULATION_BIPHASE
+			};
+
+			struct EventNewTokenData {
+				uint8_t              carrierDivider;
+				Modulation           modulation;
+				const CodingDecoder *codingDecoder;
+				uint32_t             data;
+				uint8_t              versionOrCustomerId;
+			};
+
+		private:
+			struct Hypothesis;
+
+			// Bits of one coding are decoded by its own EM4100 decoder
+			struct CodingSink {
+				Hypothesis    &hypothesis;
+				Em4100Decoder &em4100Decoder;
+
+				CodingSink(Hypothesis &hypothesis, Em4100Decoder &em4100Decoder) : hypothesis(hypothesis), em4100Decoder(em4100Decoder) {
+				}
+
+				void onBit(bool isOne) {
+					this->em4100Decoder.decodeBit(isOne, *this);
+				}
+
+				void onToken(Em4100Decoder::EventNewTokenData &data) {
+					this->hypothesis.bank.onToken(this->hypothesis, this->em4100Decoder, data);
+				}
+			};
+
+			// Pulses are decoded by both codings
+			struct PulseSink {
+				Hypothesis &hypothesis;
+				CodingSink  manchesterSink;
+				CodingSink  biphaseSink;
+
+				PulseSink(Hypothesis &hypothesis) :
+					hypothesis(hypothesis),
+					manchesterSink(hypothesis, hypothesis.em4100DecoderM),
+					biphaseSink(hypothesis, hypothesis.em4100DecoderB)
+				{
+				}
+
+				void onSyncChanged(CarrierDecoder::EventSyncData &data) {
+					this->hypothesis.manchesterDecoder.reset();
+					this->hypothesis.biphaseDecoder.reset();
+				}
+
+				void onPulse(CarrierDecoder::EventPulseData &data) {
+					this->hypothesis.manchesterDecoder.decodePulse(data, this->manchesterSink);
+					this->hypothesis.biphaseDecoder.decodePulse(data, this->biphaseSink);
+				}
+			};
+
+			struct Hypothesis {
+				DecoderBank      &bank;
+				CarrierDecoder    carrierDecoder;
+				ManchesterDecoder manchesterDecoder;
+				BiphaseDecoder    biphaseDecoder;
+				Em4100Decoder     em4100DecoderM;
+				Em4100Decoder     em4100DecoderB;
+				PulseSink         sink;
+
+				// Pulse classes of the current block, valid from the sample the hypothesis was first fed
+				uint8_t pulseClasses[CarrierDecoder::CLASSIFY_BLOCK];
+				bool    classified;
+
+				Hypothesis(DecoderBank &bank, uint8_t carrierDivider);
+			};
+
+			// Recovers tokens from fragments of the detected data rate
+			struct SoftSink {
+				DecoderBank &bank;
+				Hypothesis  &hypothesis;
+				Modulation   modulation;
+
+				SoftSink(DecoderBank &bank, Hypothesis &hypothesis, Modulation modulation) : bank(bank), hypothesis(hypothesis), modulation(modulation) {
+				}
+
+				void onToken(Em4100Decoder::EventNewTokenData &data) {
+					this->bank.notifyToken(this->hypothesis, this->modulation, data);
+				}
+			};
+
+			std::vector<std::unique_ptr<Hypothesis>> hypotheses;
+
+			SoftDecoder softDecoderM;
+			SoftDecoder softDecoderB;
+			bool        softDecision;
+			// Tail of the continuous fragment decoded by the previous call
+			std::vector<rfid::device::Interface::Sample> softSamples;
+			// Token was notified by current checkPulses() call
+			bool        tokenFound;
+
+			Hypothesis    *winner;
+			Em4100Decoder *winnerDecoder;
+			// Hypothesis matching data rate found by BitrateDetector
+			Hypothesis    *detected;
+
+		private:
+			DecoderBank(const DecoderBank &other) = delete;
+
+		public:
+			DecoderBank();
+			DecoderBank(const std::vector<uint8_t> &carrierDividers);
+			virtual ~DecoderBank();
+
+			// Resets state of every hypothesis
+			void reset();
+
+			// Marks a gap, the next samples do not continue the previous ones
+			void restart();
+
+			void setClockRecovery(CarrierDecoder::ClockRecovery clockRecovery);
+			void setSoftDecision(bool enabled);
+
+			void checkPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount);
+
+			void checkPulses(const std::vector<rfid::device::Interface::Sample> &samples) {
+				this->checkPulses(samples.data(), samples.size());
+			}
+
+		private:
+			void init(const std::vector<uint8_t> &carrierDividers);
+			void checkPulses(Hypothesis &hypothesis, const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t start, size_t end);
+			void onToken(Hypothesis &hypothesis, Em4100Decoder &decoder, Em4100Decoder::EventNewTokenData &token);
+			void notifyToken(Hypothesis &hypothesis, Modulation modulation, Em4100Decoder::EventNewTokenData &token);
+			void detect(const rfid::device::Interface::Sample *samples, size_t samplesCount);
+			void softDecode(const rfid::device::Interface::Sample *samples, size_t samplesCount);
+	};
+}
+
+#endif /* RFID_DECODERBANK_HPP_ */
@@ -18,6 +18,8 @@
 #ifndef RFID_EM4100DECODER_HPP_
 #define RFID_EM4100DECODER_HPP_
 
+#include <cstdint>
+
 #include "common/Notifier.hpp"
 #include "rfid/CodingDecoder.hpp"
 
@@ -31,25 +33,36 @@ namespace rfid {
 			struct EventNewTokenData {
 				uint32_t data;
 				uint8_t  versionOrCustomerId;
+				// Frame was found in negated bits
+				bool     isInverted;
 			};
 
 		private:
-			enum DecoderState {
-				DECODER_STATE_PREAMBLE,
-				DECODER_STATE_DATA
-			};
+			// Frame in the window, the first bit is the MSB:
+			// 9 header ones, 10 rows of 4 data bits and even parity, 4 column parity bits, stop bit
+			static const uint64_t FRAME_DATA_MASK  = (1ULL << 55) - 1;
+			static const uint64_t ROW_PARITY_MASK  = 0x0004210842108420ULL;
+			static const uint64_t COL_PARITY_MASK  = 0x1e;
+			static const uint64_t STOP_BIT_MASK    = 0x01;
+			static const uint32_t HEADER           = 0x1ff;
 
-			DecoderState state;
+			// Last decoded bits, the newest one is the LSB
+			uint64_t window;
+			uint8_t  bitCount;
 
-			uint8_t bitCount;
+			CodingDecoder *codingDecoder;
 
-			uint8_t nibble;
-			uint8_t nibbleLen;
-			uint8_t nibbleCount;
+			// Forwards decoded tokens to listeners
+			struct NotifierSink {
+				Em4100Decoder &decoder;
 
-			uint8_t data[6];
+				NotifierSink(Em4100Decoder &decoder) : decoder(decoder) {
+				}
 
-			CodingDecoder *codingDecoder;
+				void onToken(EventNewTokenData &data) {
+					this->decoder.notify(EVENT_NEW_TOKEN, &data);
+				}
+			};
 
 		public:
 			Em4100Decoder(CodingDecoder *codingDecoder);
@@ -60,7 +73,90 @@ namespace rfid {
 			void onEvent(common::Notifier &notifier, const int eventId, void *eventData);
 
 			CodingDecoder *getCodingDecoder();
+
+			// Decodes single bit, tokens are passed directly to the sink implementing
+			// onToken(EventNewTokenData &)
+			template <class Sink>
+			void decodeBit(bool isOne, Sink &sink);
+
+			// Validates header, row and column parities and stop bit at once
+			static bool checkFrame(uint64_t frame);
+			// Fixes a single bit error located by row and column parities. The error has to hit
+			// one of suspectMask bits, returns false when the frame cannot be corrected.
+			static bool correctFrame(uint64_t frame, uint64_t suspectMask, uint64_t &corrected);
+			static void getToken(uint64_t frame, EventNewTokenData &token);
 	};
 }
 
+
+inline bool rfid::Em4100Decoder::checkFrame(uint64_t frame) {
+	uint64_t fold;
+
+	if ((frame >> 55) != HEADER || (frame & STOP_BIT_MASK)) {
+		return false;
+	}
+
+	// Parity of every row lands on its parity bit position
+	fold = frame ^ (frame >> 1) ^ (frame >> 2) ^ (frame >> 3) ^ (frame >> 4);
+	if (fold & ROW_PARITY_MASK) {
+		return false;
+	}
+
+	// XOR of all 5 bit groups, columns have to cancel out with the column parity
+	fold  = frame & FRAME_DATA_MASK;
+	fold ^= fold >> 5;
+	fold ^= fold >> 10;
+	fold ^= fold >> 20;
+	fold ^= fold >> 40;
+
+	return (fold & COL_PARITY_MASK) == 0;
+}
+
+
+inline void rfid::Em4100Decoder::getToken(uint64_t frame, EventNewTokenData &token) {
+	token.versionOrCustomerId = 0;
+	token.data                = 0;
+
+	for (int row = 0; row < 10; row++) {
+		uint8_t nibble = (frame >> (51 - 5 * row)) & 0x0f;
+
+		if (row < 2) {
+			token.versionOrCustomerId = (token.versionOrCustomerId << 4) | nibble;
+
+		} else {
+			token.data = (token.data << 4) | nibble;
+		}
+	}
+}
+
+
+template <class Sink>
+inline void rfid::Em4100Decoder::decodeBit(bool isOne, Sink &sink) {
+	this->window = (this->window << 1) | isOne;
+
+	if (this->bitCount < 64) {
+		if (++this->bitCount < 64) {
+			return;
+		}
+	}
+
+	// Frame is checked at every bit offset, in both polarities
+	if (checkFrame(this->window)) {
+		EventNewTokenData eventData;
+
+		getToken(this->window, eventData);
+		eventData.isInverted = false;
+
+		sink.onToken(eventData);
+
+	} else if (checkFrame(~this->window)) {
+		EventNewTokenData eventData;
+
+		getToken(~this->window, eventData);
+		eventData.isInverted = true;
+
+		sink.onToken(eventData);
+	}
+}
+
 #endif /* RFID_EM4100DECODER_HPP_ */
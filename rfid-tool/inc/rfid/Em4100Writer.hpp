@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_EM4100WRITER_HPP_
+#define RFID_EM4100WRITER_HPP_
+
+#include <cstdint>
+
+#include "rfid/Interface.hpp"
+#include "rfid/T5557Encoder.hpp"
+
+namespace rfid {
+	class Em4100Writer {
+		private:
+			Em4100Writer() = delete;
+			Em4100Writer(const Em4100Writer &other) = delete;
+
+		public:
+			// Programs T5557 token to act as EM4100 token with given customer ID and data
+			static void write(rfid::device::Interface &iface, T5557Encoder::DataRate dataRate, T5557Encoder::Modulation modulation, uint8_t customerId, uint32_t token);
+	};
+}
+
+#endif /* RFID_EM4100WRITER_HPP_ */
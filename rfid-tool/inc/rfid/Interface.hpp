@@ -20,14 +20,32 @@
 
 #include <memory>
 #include <vector>
+#include <functional>
+#include <type_traits>
+#include <cstdint>
 
 #include "common/Exception.hpp"
+#include "common/RingBuffer.hpp"
 
 namespace rfid {
 	namespace device {
 		class Interface {
 			public:
-				static const int CARRIER_US;
+				static constexpr int CARRIER_US = 8;
+
+				// Frames held by a shortened capture, enough for the default vote in one capture
+				static constexpr uint8_t CAPTURE_WINDOW_FRAMES = 2;
+
+				enum RxMode {
+					// One bit per sample
+					RX_MODE_BITMAP,
+					// Run length encoded samples at a finer sampling step, resolves pulse widths twice as
+					// finely as bitmap, but holds only about two frames at any bitrate
+					RX_MODE_RLE,
+					// Durations between signal edges in carrier periods, finest pulse widths, but like RLE
+					// holds only about two frames at any bitrate
+					RX_MODE_EDGE_TIMING
+				};
 
 			public:
 				class NotConnectedException : public common::Exception {
@@ -105,43 +123,121 @@ namespace rfid {
 						}
 				};
 
+				/*
+				 * Signal level and its length in carrier periods packed in 16 bits, the top bit holds
+				 * the level. Trivially copyable, so vectors and rings of samples are plain arrays.
+				 */
 				class Sample {
 					public:
-						virtual ~Sample() {}
+						static const uint16_t LEVEL_MASK  = 0x8000;
+						static const uint16_t LENGTH_MASK = 0x7fff;
+
+					public:
+						Sample() {
+							this->value = 0;
+						}
 
+						// Length is rounded to carrier periods and saturated
 						Sample(int sampleUs, bool isHigh) {
-							this->sampleUs = sampleUs;
-							this->isHigh   = isHigh;
+							int carriers = (sampleUs + CARRIER_US / 2) / CARRIER_US;
+
+							if ((carriers == 0) && (sampleUs > 0)) {
+								carriers = 1;
+							}
+
+							this->value = (isHigh ? LEVEL_MASK : 0) | (carriers > LENGTH_MASK ? LENGTH_MASK : carriers);
+						}
+
+						static Sample fromCarriers(uint32_t carriers, bool isHigh) {
+							Sample ret;
+
+							ret.value = (isHigh ? LEVEL_MASK : 0) | (carriers > LENGTH_MASK ? LENGTH_MASK : carriers);
+
+							return ret;
+						}
+
+						uint16_t getLengthCarriers() const {
+							return this->value & LENGTH_MASK;
 						}
 
 						int getLengthUs() const {
-							return this->sampleUs;
+							return this->getLengthCarriers() * CARRIER_US;
 						}
 
 						bool isLow() const {
-							return ! this->isHigh;
+							return (this->value & LEVEL_MASK) == 0;
+						}
+
+						// Zero length sample marks a place where samples were dropped
+						bool isGap() const {
+							return this->getLengthCarriers() == 0;
 						}
 
 					private:
-						int  sampleUs;
-						bool isHigh;
+						uint16_t value;
 				};
 
 			public:
 				virtual ~Interface() {
 				}
 
+				// Stable identifier of the reader, unique among attached readers
+				virtual const std::string &getKey() = 0;
+
 				virtual bool isConnected() = 0;
 
 				virtual void reset() = 0;
 
 				virtual std::shared_ptr<FirmwareVersion> getVersion() = 0;
 
-				virtual std::shared_ptr<std::vector<Sample>> getSamples() = 0;
+				virtual void setRxMode(RxMode mode) = 0;
+
+				/*
+				 * Shortens captures to the window holding the given number of EM4100 frames
+				 * (64 bits each) at the carrier divider. Zero frames or divider restores captures
+				 * of the whole device buffer, which is also used when the device cannot shorten them.
+				 */
+				virtual void setCaptureWindow(uint8_t carrierDivider, uint8_t frames) = 0;
+
+				/*
+				 * Captures one device buffer. The vector is cleared, but its storage is reused, so
+				 * repeated captures into the same vector do not allocate memory.
+				 */
+				virtual void getSamples(std::vector<Sample> &samples) = 0;
+
+				/*
+				 * Captures one device buffer like getSamples(), samples are handed over to isDone()
+				 * while the device is still sampling. Vector holds all samples captured so far,
+				 * returning true stops the capture early.
+				 */
+				virtual void getSamples(std::vector<Sample> &samples, const std::function<bool(const std::vector<Sample> &samples)> &isDone) {
+					this->getSamples(samples);
+
+					isDone(samples);
+				}
+
+				std::shared_ptr<std::vector<Sample>> getSamples() {
+					std::shared_ptr<std::vector<Sample>> ret(new std::vector<Sample>);
+
+					this->getSamples(*ret);
+
+					return ret;
+				}
 
 				virtual void putSamples(const std::vector<Sample> &samples) = 0;
+
+				virtual bool isStreamingSupported() = 0;
+
+				/*
+				 * Samples continuously pushing samples to the ring until isDone() returns true.
+				 * Gap sample is pushed whenever signal was lost on the device or the ring was full.
+				 */
+				virtual void streamSamples(common::RingBuffer<Sample> &ring, const std::function<bool()> &isDone) = 0;
 		};
 	}
 }
 
+static_assert(sizeof(rfid::device::Interface::Sample) == 2, "Sample has to be packed in 16 bits");
+static_assert(std::is_trivially_copyable<rfid::device::Interface::Sample>::value, "Sample has to be trivially copyable");
+
 #endif /* RFID_TOOL_INC_INTERFACE_HPP_ */
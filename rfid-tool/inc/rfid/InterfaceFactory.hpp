@@ -17,6 +17,9 @@
 
 #pragma once
 
+#include <string>
+#include <vector>
+
 #include <rfid/Interface.hpp>
 
 namespace rfid {
@@ -29,6 +32,10 @@ namespace rfid {
 
 			public:
 				static Interface *newInstance(Type type);
+				static Interface *newInstance(Type type, const std::string &key);
+
+				// Returns keys of all attached readers of given type
+				static std::vector<std::string> enumerate(Type type);
 		};
 	}
 }
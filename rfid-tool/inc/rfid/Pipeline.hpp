@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_PIPELINE_HPP_
+#define RFID_PIPELINE_HPP_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "common/Notifier.hpp"
+#include "rfid/Interface.hpp"
+#include "rfid/CarrierDecoder.hpp"
+#include "rfid/Em4100Decoder.hpp"
+#include "rfid/impl/ManchesterDecoder.hpp"
+#include "rfid/impl/BiphaseDecoder.hpp"
+
+namespace rfid {
+	/*
+	 * Carrier, coding and EM4100 decoders chained at compile time. Pulses and bits are passed by
+	 * direct calls which the compiler inlines, only decoded tokens are notified to listeners.
+	 * Pulses are classified a block at a time, as DecoderBank does for its winner.
+	 */
+	template <class Coding>
+	class Pipeline : public common::Notifier {
+		public:
+			enum Event {
+				// Event data: Em4100Decoder::EventNewTokenData
+				EVENT_NEW_TOKEN
+			};
+
+		private:
+			struct Sink {
+				Pipeline &pipeline;
+
+				Sink(Pipeline &pipeline) : pipeline(pipeline) {
+				}
+
+				void onSyncChanged(CarrierDecoder::EventSyncData &data) {
+					this->pipeline.codingDecoder.reset();
+				}
+
+				void onPulse(CarrierDecoder::EventPulseData &data) {
+					this->pipeline.codingDecoder.decodePulse(data, *this);
+				}
+
+				void onBit(bool isOne) {
+					this->pipeline.em4100Decoder.decodeBit(isOne, *this);
+				}
+
+				void onToken(Em4100Decoder::EventNewTokenData &data) {
+					this->pipeline.notify(EVENT_NEW_TOKEN, &data);
+				}
+			};
+
+			CarrierDecoder carrierDecoder;
+			Coding         codingDecoder;
+			Em4100Decoder  em4100Decoder;
+
+		private:
+			Pipeline(const Pipeline &other) = delete;
+
+		public:
+			Pipeline() : codingDecoder(&carrierDecoder), em4100Decoder(&codingDecoder) {
+			}
+
+			Pipeline(uint8_t carrierDivider) : carrierDecoder(carrierDivider), codingDecoder(&carrierDecoder), em4100Decoder(&codingDecoder) {
+			}
+
+			virtual ~Pipeline() {
+			}
+
+			void reset() {
+				this->carrierDecoder.reset();
+				this->codingDecoder.reset();
+				this->em4100Decoder.reset();
+			}
+
+			void checkPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount) {
+				Sink    sink(*this);
+				uint8_t pulseClasses[CarrierDecoder::CLASSIFY_BLOCK];
+
+				for (size_t block = 0; block < samplesCount; block += CarrierDecoder::CLASSIFY_BLOCK) {
+					size_t blockSize = std::min(CarrierDecoder::CLASSIFY_BLOCK, samplesCount - block);
+
+					this->carrierDecoder.classifyBlock(samples + block, blockSize, pulseClasses);
+					this->carrierDecoder.checkPulses(samples + block, blockSize, 0, blockSize, pulseClasses, sink);
+				}
+			}
+
+			void checkPulses(const std::vector<rfid::device::Interface::Sample> &samples) {
+				this->checkPulses(samples.data(), samples.size());
+			}
+
+			CarrierDecoder &getCarrierDecoder() {
+				return this->carrierDecoder;
+			}
+
+			Coding &getCodingDecoder() {
+				return this->codingDecoder;
+			}
+	};
+
+	typedef Pipeline<ManchesterDecoder> ManchesterPipeline;
+	typedef Pipeline<BiphaseDecoder>    BiphasePipeline;
+}
+
+#endif /* RFID_PIPELINE_HPP_ */
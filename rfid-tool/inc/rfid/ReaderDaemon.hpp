@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_READERDAEMON_HPP_
+#define RFID_READERDAEMON_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "rfid/Interface.hpp"
+#include "rfid/InterfaceFactory.hpp"
+#include "rfid/DecoderBank.hpp"
+#include "rfid/TokenVoter.hpp"
+
+namespace rfid {
+	/*
+	 * Long running server keeping the interface opened and the decoder chain ready. Requests are
+	 * received on a unix domain socket, framing is described in rfid/DaemonProtocol.h.
+	 */
+	class ReaderDaemon : public common::Listener {
+		private:
+			// Sockets are non-blocking, request is dispatched once it was received completely
+			struct Client {
+				int                  fd;
+				std::vector<uint8_t> rxBuffer;
+			};
+
+		private:
+			std::string socketPath;
+			int         listenFd;
+			std::vector<Client> clients;
+
+			rfid::device::InterfaceFactory::Type     type;
+			std::string                              deviceKey;
+			rfid::device::Interface::RxMode          rxMode;
+			std::unique_ptr<rfid::device::Interface> iface;
+
+			// Reused by every capture
+			std::vector<rfid::device::Interface::Sample> samples;
+
+			rfid::DecoderBank decoderBank;
+			rfid::TokenVoter  voter;
+
+			// First token confirmed by the voter in current request
+			bool                                 tokenFound;
+			rfid::DecoderBank::EventNewTokenData token;
+
+		private:
+			ReaderDaemon(const ReaderDaemon &other) = delete;
+
+		public:
+			ReaderDaemon(const std::string &socketPath, rfid::device::InterfaceFactory::Type type, const std::string &deviceKey, rfid::device::Interface::RxMode rxMode);
+			virtual ~ReaderDaemon();
+
+			// Serves requests until isDone() returns true
+			void run(const std::function<bool()> &isDone);
+
+			void onEvent(common::Notifier &notifier, const int eventId, void *eventData);
+
+		private:
+			bool handleClient(Client &client);
+			uint8_t handleRequest(uint8_t command, const uint8_t *payload, uint16_t payloadSize, std::vector<uint8_t> &response);
+
+			rfid::device::Interface &getInterface();
+
+			bool readToken(uint8_t captures);
+	};
+}
+
+#endif /* RFID_READERDAEMON_HPP_ */
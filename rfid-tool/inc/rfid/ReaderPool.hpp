@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_READERPOOL_HPP_
+#define RFID_READERPOOL_HPP_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/Notifier.hpp"
+#include "rfid/Interface.hpp"
+
+namespace rfid {
+	/*
+	 * Runs capture and EM4100 decoding on several readers in parallel, one thread per reader.
+	 * Tokens are reported once confirmed by TokenVoter.
+	 * Events are delivered from reader threads, but never concurrently.
+	 */
+	class ReaderPool : public common::Notifier {
+		public:
+			enum Event {
+				EVENT_NEW_TOKEN,
+				EVENT_READER_ERROR
+			};
+
+			struct EventNewTokenData {
+				const std::string *readerKey;
+				uint8_t            carrierDivider;
+				const std::string *modulation;
+				uint32_t           data;
+				uint8_t            versionOrCustomerId;
+				// Agreeing frames out of all frames of the vote (percent)
+				uint8_t            confidence;
+			};
+
+			struct EventReaderErrorData {
+				const std::string *readerKey;
+				const std::string *message;
+			};
+
+		private:
+			struct Reader {
+				std::unique_ptr<rfid::device::Interface> iface;
+				std::thread                              thread;
+			};
+
+			std::vector<std::unique_ptr<Reader>> readers;
+			std::atomic<bool>                    running;
+			std::mutex                           notifyMutex;
+
+		private:
+			ReaderPool(const ReaderPool &other) = delete;
+
+		public:
+			ReaderPool();
+			virtual ~ReaderPool();
+
+			// Pool takes ownership of the interface
+			void addReader(rfid::device::Interface *iface);
+
+			void start();
+			void stop();
+
+		private:
+			void run(Reader &reader);
+	};
+}
+
+#endif /* RFID_READERPOOL_HPP_ */
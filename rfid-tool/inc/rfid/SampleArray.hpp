@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_SAMPLEARRAY_HPP_
+#define RFID_SAMPLEARRAY_HPP_
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "rfid/Interface.hpp"
+
+namespace rfid {
+	namespace device {
+		/*
+		 * Struct-of-arrays sample storage: lengths (carrier periods) in one array, levels packed in
+		 * a bitmap. Length classification can run over the lengths array alone.
+		 */
+		class SampleArray {
+			private:
+				std::vector<uint16_t> lengths;
+				std::vector<uint64_t> levels;
+
+			public:
+				SampleArray() {
+				}
+
+				SampleArray(const std::vector<Interface::Sample> &samples) {
+					this->assign(samples);
+				}
+
+				void clear() {
+					this->lengths.clear();
+					this->levels.clear();
+				}
+
+				void reserve(size_t size) {
+					this->lengths.reserve(size);
+					this->levels.reserve((size + 63) / 64);
+				}
+
+				size_t size() const {
+					return this->lengths.size();
+				}
+
+				void assign(const std::vector<Interface::Sample> &samples) {
+					this->clear();
+					this->reserve(samples.size());
+
+					for (const auto &sample : samples) {
+						this->push_back(sample);
+					}
+				}
+
+				void push_back(const Interface::Sample &sample) {
+					size_t idx = this->lengths.size();
+
+					if ((idx & 63) == 0) {
+						this->levels.push_back(0);
+					}
+
+					this->lengths.push_back(sample.getLengthCarriers());
+
+					if (! sample.isLow()) {
+						this->levels[idx >> 6] |= ((uint64_t) 1) << (idx & 63);
+					}
+				}
+
+				bool isHigh(size_t idx) const {
+					return (this->levels[idx >> 6] >> (idx & 63)) & 1;
+				}
+
+				Interface::Sample operator[](size_t idx) const {
+					return Interface::Sample::fromCarriers(this->lengths[idx], this->isHigh(idx));
+				}
+
+				const uint16_t *getLengths() const {
+					return this->lengths.data();
+				}
+
+				const uint64_t *getLevels() const {
+					return this->levels.data();
+				}
+		};
+	}
+}
+
+#endif /* RFID_SAMPLEARRAY_HPP_ */
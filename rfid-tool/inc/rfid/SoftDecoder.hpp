@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_SOFTDECODER_HPP_
+#define RFID_SOFTDECODER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include "common/Notifier.hpp"
+#include "rfid/Interface.hpp"
+#include "rfid/Em4100Decoder.hpp"
+
+namespace rfid {
+	/*
+	 * Soft-decision EM4100 decoder for captures the hard decision chain fails on.
+	 *
+	 * Pulses are not classified one by one. Every pulse may span 1 - 4 half bit cells and the cost
+	 * of each choice grows with the distance of the pulse length from it. A Viterbi search over the
+	 * bit phase finds the cheapest cell sequence of the whole fragment. Pulses breaking the coding
+	 * rules are accepted at a penalty, their bits are marked as suspect together with bits of pulses
+	 * far from any cell multiple. A frame failing parity is corrected when the single error located
+	 * by its row and column parities hits a suspect bit.
+	 */
+	class SoftDecoder : public common::Notifier {
+		public:
+			enum Event {
+				// Event data is Em4100Decoder::EventNewTokenData
+				EVENT_NEW_TOKEN
+			};
+
+			enum Coding {
+				CODING_MANCHESTER,
+				CODING_BIPHASE
+			};
+
+		private:
+			static const uint8_t  CELLS_MAX      = 4;
+			// Cost of a pulse breaking the coding rules, the same as a pulse half cell off
+			static const uint32_t VIOLATION_COST = 64;
+			// Length error (1/16 of cell) making the pulse suspect, the hard decision window ends here
+			static const uint32_t SUSPECT_ERROR  = 4;
+			static const uint32_t ERROR_MAX      = 32;
+
+			static const uint8_t CELL_HIGH    = 0x01;
+			static const uint8_t CELL_SUSPECT = 0x02;
+
+			// Forwards decoded tokens to listeners
+			struct NotifierSink {
+				SoftDecoder &decoder;
+
+				NotifierSink(SoftDecoder &decoder) : decoder(decoder) {
+				}
+
+				void onToken(Em4100Decoder::EventNewTokenData &data) {
+					this->decoder.notify(EVENT_NEW_TOKEN, &data);
+				}
+			};
+
+			uint8_t carrierDivider;
+			Coding  coding;
+
+			// Cells count chosen for every pulse, low nibble for even end phase, high nibble for odd
+			std::vector<uint8_t> choices;
+			// Half bit cells of the best path, the first one starts a bit
+			std::vector<uint8_t> cells;
+			// Frames ending before this cell were reported already
+			size_t               reportCell;
+
+		public:
+			SoftDecoder(uint8_t carrierDivider, Coding coding);
+			virtual ~SoftDecoder();
+
+			void setCarrierDivider(uint8_t carrierDivider);
+
+			uint8_t getCarrierDivider() const {
+				return this->carrierDivider;
+			}
+
+			void decode(const rfid::device::Interface::Sample *samples, size_t samplesCount);
+
+			// Tokens are passed directly to the sink implementing onToken(Em4100Decoder::EventNewTokenData &)
+			template <class Sink>
+			void decode(const rfid::device::Interface::Sample *samples, size_t samplesCount, Sink &sink) {
+				this->decode(samples, samplesCount, 0, sink);
+			}
+
+			// Samples before reportFrom only give context to the search, frames ending in them are
+			// not reported. Used to decode a stream in chunks overlapping by reportFrom samples.
+			template <class Sink>
+			void decode(const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t reportFrom, Sink &sink);
+
+		private:
+			// Fills cells with the best path through continuous samples
+			void align(const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t reportFrom);
+
+			uint32_t getLengthError(uint16_t pulseLength, uint8_t cellsCount) const;
+			uint8_t  getViolations(uint8_t phase, uint8_t cellsCount) const;
+
+			template <class Sink>
+			void decodeFrames(Sink &sink);
+	};
+}
+
+
+template <class Sink>
+inline void rfid::SoftDecoder::decode(const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t reportFrom, Sink &sink) {
+	size_t start = 0;
+
+	// Every continuous fragment is aligned on its own
+	for (size_t i = 0; i <= samplesCount; i++) {
+		if ((i == samplesCount) || samples[i].isGap()) {
+			if ((i - start >= 64) && (i > reportFrom)) {
+				this->align(samples + start, i - start, (reportFrom > start) ? reportFrom - start : 0);
+				this->decodeFrames(sink);
+			}
+
+			start = i + 1;
+		}
+	}
+}
+
+
+template <class Sink>
+void rfid::SoftDecoder::decodeFrames(Sink &sink) {
+	uint64_t window  = 0;
+	uint64_t suspect = 0;
+
+	for (size_t i = 0; i + 1 < this->cells.size(); i += 2) {
+		uint8_t first  = this->cells[i];
+		uint8_t second = this->cells[i + 1];
+		bool    isOne;
+
+		if (this->coding == CODING_MANCHESTER) {
+			isOne = (second & CELL_HIGH) != 0;
+
+		} else {
+			isOne = ((first ^ second) & CELL_HIGH) == 0;
+		}
+
+		window  = (window << 1) | isOne;
+		suspect = (suspect << 1) | (((first | second) & CELL_SUSPECT) != 0);
+
+		if ((i < 2 * 63) || (i + 1 < this->reportCell)) {
+			continue;
+		}
+
+		{
+			Em4100Decoder::EventNewTokenData eventData;
+			uint64_t                         frame;
+
+			if (Em4100Decoder::checkFrame(window)) {
+				frame                = window;
+				eventData.isInverted = false;
+
+			} else if (Em4100Decoder::checkFrame(~window)) {
+				frame                = ~window;
+				eventData.isInverted = true;
+
+			} else if (suspect == 0) {
+				continue;
+
+			} else if (Em4100Decoder::correctFrame(window, suspect, frame)) {
+				eventData.isInverted = false;
+
+			} else if (Em4100Decoder::correctFrame(~window, suspect, frame)) {
+				eventData.isInverted = true;
+
+			} else {
+				continue;
+			}
+
+			Em4100Decoder::getToken(frame, eventData);
+
+			sink.onToken(eventData);
+		}
+	}
+}
+
+#endif /* RFID_SOFTDECODER_HPP_ */
@@ -86,6 +86,9 @@ namespace rfid {
 			static void encodeParameters(const Parameters &params, bool passwordSend, uint32_t password, std::vector<rfid::device::Interface::Sample> &samples);
 
 			static void encodeBlock(uint8_t page, uint8_t block, bool lock, bool passwordSend, uint32_t password, uint32_t data, std::vector<rfid::device::Interface::Sample> &samples);
+
+			// Maps carrier divider (RF/n) to data rate, returns false if the rate is not supported
+			static bool getDataRate(uint8_t carrierDivider, DataRate &dataRate);
 	};
 }
 
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_TOKENVOTER_HPP_
+#define RFID_TOKENVOTER_HPP_
+
+#include <atomic>
+#include <cstdint>
+
+#include "common/Notifier.hpp"
+#include "rfid/DecoderBank.hpp"
+
+namespace rfid {
+	/*
+	 * Collects frames decoded by DecoderBank and notifies a token once enough frames agree on it.
+	 * Votes are kept across captures until reset(), so a short capture holding a single frame
+	 * is completed by the next one. After a token is notified a new round of voting starts.
+	 */
+	class TokenVoter : public common::Listener, public common::Notifier {
+		public:
+			static const uint8_t VOTES_DEFAULT = 2;
+
+			enum Event {
+				EVENT_NEW_TOKEN
+			};
+
+			struct EventNewTokenData {
+				const DecoderBank::EventNewTokenData *token;
+				// Frames agreeing on the token
+				uint8_t                               votes;
+				// Agreeing frames out of all frames of the round (percent)
+				uint8_t                               confidence;
+			};
+
+		private:
+			static const uint8_t CANDIDATES_MAX = 4;
+
+			struct Candidate {
+				DecoderBank::EventNewTokenData token;
+				uint8_t                        votes;
+			};
+
+			Candidate candidates[CANDIDATES_MAX];
+			uint8_t   candidatesCount;
+			uint8_t   frames;
+			uint8_t   votesRequired;
+
+			// Read by acquisition threads to stop early
+			std::atomic<bool> confident;
+
+		private:
+			TokenVoter(const TokenVoter &other) = delete;
+
+		public:
+			TokenVoter(uint8_t votesRequired = VOTES_DEFAULT);
+			virtual ~TokenVoter();
+
+			void reset();
+
+			void setVotesRequired(uint8_t votesRequired);
+
+			// Token was notified since reset()
+			bool isConfident() const {
+				return this->confident;
+			}
+
+			void onEvent(common::Notifier &notifier, const int eventId, void *eventData);
+
+		private:
+			void startRound();
+	};
+}
+
+#endif /* RFID_TOKENVOTER_HPP_ */
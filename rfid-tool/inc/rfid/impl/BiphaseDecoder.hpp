@@ -26,9 +26,33 @@ namespace rfid {
 				return "Biphase";
 			}
 
+			// Decodes single pulse, bits are passed directly to the sink implementing onBit(bool)
+			template <class Sink>
+			void decodePulse(const CarrierDecoder::EventPulseData &pulse, Sink &sink);
+
 		public:
 			virtual void onEvent(common::Notifier &notifier, const int eventId, void *eventData);
 	};
 }
 
+
+template <class Sink>
+inline void rfid::BiphaseDecoder::decodePulse(const CarrierDecoder::EventPulseData &pulse, Sink &sink) {
+	if (pulse.isLong) {
+		this->_lastShort = false;
+
+		sink.onBit(true);
+
+	} else {
+		if (this->_lastShort) {
+			this->_lastShort = false;
+
+			sink.onBit(false);
+
+		} else {
+			this->_lastShort = true;
+		}
+	}
+}
+
 #endif /* RFID_BIPHASEDECODER_HPP_ */
@@ -20,9 +20,43 @@ namespace rfid {
 				return "Manchester";
 			}
 
+			// Decodes single pulse, bits are passed directly to the sink implementing onBit(bool)
+			template <class Sink>
+			void decodePulse(const CarrierDecoder::EventPulseData &pulse, Sink &sink);
+
 		public:
 			virtual void onEvent(common::Notifier &notifier, const int eventId, void *eventData);
 	};
 }
 
+
+template <class Sink>
+inline void rfid::ManchesterDecoder::decodePulse(const CarrierDecoder::EventPulseData &pulse, Sink &sink) {
+	if (this->timerRunning) {
+		this->ffOut        = pulse.isHigh;
+		this->timerRunning = pulse.isLong;
+
+		sink.onBit(this->ffOut);
+
+		if (this->timerRunning) {
+			this->timerRunning = this->ffOut ^ (pulse.isHigh);
+		}
+
+	} else {
+		bool timerTrigger = pulse.isHigh ^ this->ffOut;
+
+		if (timerTrigger) {
+			if (pulse.isLong) {
+				this->timerRunning = false;
+				this->ffOut        = pulse.isHigh;
+
+				sink.onBit(this->ffOut);
+
+			} else {
+				this->timerRunning = true;
+			}
+		}
+	}
+}
+
 #endif /* RFID_MANCHESTERDECODER_HPP_ */
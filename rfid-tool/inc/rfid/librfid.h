@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RFID_LIBRFID_H_
+#define RFID_LIBRFID_H_
+
+/*
+ * C interface of librfid. All buffers are owned by the caller, the library never returns memory
+ * which has to be released by the caller. Functions return RFID_OK or one of negative RFID_ERR_*
+ * codes.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+	#define RFID_API __attribute__((visibility("default")))
+#else
+	#define RFID_API
+#endif
+
+/* Incremented on every incompatible change of this interface */
+#define RFID_API_VERSION 1
+
+#define RFID_OK                     0
+#define RFID_ERR_INVALID_ARG       -1
+#define RFID_ERR_NOT_CONNECTED     -2
+#define RFID_ERR_TIMEOUT           -3
+#define RFID_ERR_DEVICE            -4
+#define RFID_ERR_NO_TOKEN          -5
+#define RFID_ERR_BUFFER_TOO_SMALL  -6
+#define RFID_ERR_INTERNAL          -7
+
+#define RFID_MODULATION_MANCHESTER 0
+#define RFID_MODULATION_BIPHASE    1
+
+#define RFID_RX_MODE_BITMAP      0
+#define RFID_RX_MODE_RLE         1
+#define RFID_RX_MODE_EDGE_TIMING 2
+
+typedef struct rfid_reader  rfid_reader;
+typedef struct rfid_decoder rfid_decoder;
+
+typedef struct {
+	/* Sample length in microseconds, 0 marks a gap in the signal */
+	uint32_t length_us;
+	/* 1 - high level, 0 - low level */
+	uint8_t  high;
+} rfid_sample;
+
+typedef struct {
+	uint8_t  carrier_divider;
+	uint8_t  modulation;
+	uint8_t  customer_id;
+	uint32_t data;
+} rfid_token;
+
+RFID_API int rfid_api_version(void);
+
+RFID_API const char *rfid_strerror(int error);
+
+/*
+ * Stores keys of attached readers in the buffer as consecutive NUL terminated strings.
+ * *count is set to number of stored keys.
+ */
+RFID_API int rfid_enumerate(char *buffer, size_t buffer_size, size_t *count);
+
+/* Opens reader with given key, NULL or empty key opens the first attached reader */
+RFID_API int  rfid_open(const char *key, rfid_reader **reader);
+RFID_API void rfid_close(rfid_reader *reader);
+
+RFID_API int rfid_get_version(rfid_reader *reader, uint8_t *major, uint8_t *minor);
+RFID_API int rfid_set_rx_mode(rfid_reader *reader, int rx_mode);
+
+/*
+ * Captures one device buffer. On RFID_ERR_BUFFER_TOO_SMALL *count holds required number
+ * of samples and first capacity samples are stored.
+ */
+RFID_API int rfid_capture(rfid_reader *reader, rfid_sample *samples, size_t capacity, size_t *count);
+
+/*
+ * Captures up to max_captures buffers until enough EM4100 frames agree on a token. Frames are
+ * collected across captures, reading stops as soon as the token is confirmed.
+ */
+RFID_API int rfid_read_token(rfid_reader *reader, unsigned max_captures, rfid_token *token);
+
+/* Sets number of agreeing frames required by rfid_read_token(), 2 by default */
+RFID_API int rfid_set_votes(rfid_reader *reader, unsigned votes);
+
+/*
+ * Converts raw sampler bitmap (one bit per sample period of prescaler carrier cycles, LSB first),
+ * e.g. a recorded capture, into samples. Semantics of capacity and count match rfid_capture().
+ */
+RFID_API int rfid_decode_bitmap(const uint8_t *bitmap, size_t bitmap_size, uint16_t prescaler, rfid_sample *samples, size_t capacity, size_t *count);
+
+/* Programs T5557 token to act as EM4100 token */
+RFID_API int rfid_write_token(rfid_reader *reader, uint8_t carrier_divider, uint8_t modulation, uint8_t customer_id, uint32_t data);
+
+/*
+ * Standalone decoder chain (carrier, Manchester/Biphase, EM4100). The state is kept between
+ * rfid_decoder_feed() calls, so samples may be fed in chunks of any size.
+ */
+RFID_API int  rfid_decoder_new(rfid_decoder **decoder);
+RFID_API void rfid_decoder_free(rfid_decoder *decoder);
+RFID_API void rfid_decoder_reset(rfid_decoder *decoder);
+
+/* Decodes samples, stores up to capacity tokens and sets *count to number of stored tokens */
+RFID_API int rfid_decoder_feed(rfid_decoder *decoder, const rfid_sample *samples, size_t samples_count, rfid_token *tokens, size_t capacity, size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RFID_LIBRFID_H_ */
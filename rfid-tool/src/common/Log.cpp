@@ -31,7 +31,7 @@ void Log::setLevel(Level level) {
 }
 
 
-void Log::report(Level level, const std::string &format, ...) {
+void Log::report(Level level, const char *format, ...) {
 	va_list args;
 
 	va_start(args, format);
@@ -42,7 +42,7 @@ void Log::report(Level level, const std::string &format, ...) {
 }
 
 
-void Log::report(Level level, const std::string &format, va_list &list) {
+void Log::report(Level level, const char *format, va_list &list) {
 	if (_level >= level) {
 		switch (level) {
 			case DEBUG: printf("[DBG]: "); break;
@@ -53,13 +53,13 @@ void Log::report(Level level, const std::string &format, va_list &list) {
 				break;
 		}
 
-		vprintf(format.c_str(), list);
+		vprintf(format, list);
 		printf("\n");
 	}
 }
 
 
-void Log::debug(const std::string &format, ...) {
+void Log::debug(const char *format, ...) {
 	va_list args;
 
 	va_start(args, format);
@@ -70,7 +70,7 @@ void Log::debug(const std::string &format, ...) {
 }
 
 
-void Log::log(const std::string &format, ...) {
+void Log::log(const char *format, ...) {
 	va_list args;
 
 	va_start(args, format);
@@ -81,7 +81,7 @@ void Log::log(const std::string &format, ...) {
 }
 
 
-void Log::warn(const std::string &format, ...) {
+void Log::warn(const char *format, ...) {
 	va_list args;
 
 	va_start(args, format);
@@ -92,7 +92,7 @@ void Log::warn(const std::string &format, ...) {
 }
 
 
-void Log::error(const std::string &format, ...) {
+void Log::error(const char *format, ...) {
 	va_list args;
 
 	va_start(args, format);
@@ -103,23 +103,23 @@ void Log::error(const std::string &format, ...) {
 }
 
 
-void Log::reportStdOut(const std::string &format, ...) {
+void Log::reportStdOut(const char *format, ...) {
 	va_list args;
 
 	va_start(args, format);
 
-	vfprintf(stdout, format.c_str(), args);
+	vfprintf(stdout, format, args);
 
 	va_end(args);
 }
 
 
-void Log::reportStdErr(const std::string &format, ...) {
+void Log::reportStdErr(const char *format, ...) {
 	va_list args;
 
 	va_start(args, format);
 
-	vfprintf(stderr, format.c_str(), args);
+	vfprintf(stderr, format, args);
 
 	va_end(args);
 }
@@ -16,16 +16,25 @@
  */
 #include <getopt.h>
 #include <string.h>
+#include <signal.h>
 
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <unistd.h>
 #include <common/Exception.hpp>
 #include <rfid/InterfaceFactory.hpp>
 #include <rfid/CarrierDecoder.hpp>
 #include <rfid/CodingDecoder.hpp>
 #include <rfid/Em4100Decoder.hpp>
-#include <rfid/Em4100Eprom.hpp>
+#include <rfid/Em4100Writer.hpp>
 #include <rfid/T5557Encoder.hpp>
+#include <rfid/ReaderPool.hpp>
+#include <rfid/DecoderBank.hpp>
+#include <rfid/TokenVoter.hpp>
+#include <rfid/ReaderDaemon.hpp>
 
 #include <rfid/impl/ManchesterDecoder.hpp>
 #include <rfid/impl/BiphaseDecoder.hpp>
@@ -33,6 +42,13 @@
 #include "common/Log.hpp"
 
 
+#define STREAM_RING_SIZE  (64 * 1024)
+#define STREAM_CHUNK_SIZE 4096
+
+// Single read gives up after this time (streaming firmware) or number of captures
+#define READ_TIMEOUT_MS   2000
+#define READ_CAPTURES_MAX 10
+
 using namespace common;
 
 enum Modulation {
@@ -50,40 +66,85 @@ enum Bitrate {
 	BITRATE_64,
 };
 
-class Em4100DecoderListener : public common::Listener {
+class TokenVoterListener : public common::Listener {
 	public:
 		void onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
-			rfid::Em4100Decoder::EventNewTokenData *data = reinterpret_cast<rfid::Em4100Decoder::EventNewTokenData *>(eventData);
+			rfid::TokenVoter::EventNewTokenData        *data  = reinterpret_cast<rfid::TokenVoter::EventNewTokenData *>(eventData);
+			const rfid::DecoderBank::EventNewTokenData *token = data->token;
 
-			rfid::Em4100Decoder &em4100Decoder = static_cast<rfid::Em4100Decoder &>(notifier);
-
-			common::Log::reportStdOut("New token, carrier divider: %u, modulation: %s, customer ID: %u (%#02x), token: %u (%#x)\n",
-				em4100Decoder.getCodingDecoder()->getCarrierDecoder()->getCarrierDivider(), em4100Decoder.getCodingDecoder()->getName().c_str(), data->versionOrCustomerId, data->versionOrCustomerId, data->data, data->data
+			common::Log::reportStdOut("New token, carrier divider: %u, modulation: %s, customer ID: %u (%#02x), token: %u (%#x), confidence: %u%%\n",
+				token->carrierDivider, token->codingDecoder->getName().c_str(), token->versionOrCustomerId, token->versionOrCustomerId, token->data, token->data, data->confidence
 			);
 		}
 };
 
+class ReaderPoolListener : public common::Listener {
+	public:
+		void onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+			switch (eventId) {
+				case rfid::ReaderPool::EVENT_NEW_TOKEN:
+					{
+						rfid::ReaderPool::EventNewTokenData *data = reinterpret_cast<rfid::ReaderPool::EventNewTokenData *>(eventData);
+
+						common::Log::reportStdOut("Reader %s: New token, carrier divider: %u, modulation: %s, customer ID: %u (%#02x), token: %u (%#x), confidence: %u%%\n",
+							data->readerKey->c_str(), data->carrierDivider, data->modulation->c_str(), data->versionOrCustomerId, data->versionOrCustomerId, data->data, data->data, data->confidence
+						);
+					}
+					break;
+
+				case rfid::ReaderPool::EVENT_READER_ERROR:
+					{
+						rfid::ReaderPool::EventReaderErrorData *data = reinterpret_cast<rfid::ReaderPool::EventReaderErrorData *>(eventData);
+
+						common::Log::reportStdErr("Reader %s: %s\n", data->readerKey->c_str(), data->message->c_str());
+					}
+					break;
+			}
+		}
+};
+
 struct ExecutionOptions {
 	bool showHelp;
 	bool resetIface;
 	bool read;
 	bool write;
+	bool stream;
+	bool list;
+	bool readAll;
+	bool pll;
+	bool soft;
+
+	uint8_t votes;
+
+	std::string device;
+	std::string daemonSocket;
 
 	uint8_t    customerId;
 	uint32_t   token;
 	Modulation modulation;
 	Bitrate    bitrate;
 
+	rfid::device::Interface::RxMode rxMode;
+
 	ExecutionOptions() {
 		this->showHelp   = false;
 		this->resetIface = false;
 		this->write      = false;
 		this->read       = false;
+		this->stream     = false;
+		this->list       = false;
+		this->readAll    = false;
+		this->pll        = false;
+		this->soft       = false;
+
+		this->votes = rfid::TokenVoter::VOTES_DEFAULT;
 
 		this->customerId = 0;
 		this->token      = 0;
 		this->modulation = MODULATION_UNKNOWN;
 		this->bitrate    = BITRATE_UNKNOWN;
+
+		this->rxMode = rfid::device::Interface::RX_MODE_BITMAP;
 	}
 };
 
@@ -92,18 +153,34 @@ static struct option longOpts[] = {
 	{ "help",       no_argument,       0, 'h' },
 	{ "reset",      no_argument,       0, 'R' },
 	{ "read",       no_argument,       0, 'r' },
+	{ "stream",     no_argument,       0, 's' },
+	{ "list",       no_argument,       0, 'l' },
+	{ "all",        no_argument,       0, 'a' },
+	{ "device",     required_argument, 0, 'd' },
+	{ "daemon",     required_argument, 0, 'D' },
 	{ "program",    no_argument,       0, 'p' },
 	{ "bitrate",    required_argument, 0, 'b' },
 	{ "modulation", required_argument, 0, 'm' },
 	{ "customerid", required_argument, 0, 'c' },
 	{ "token",      required_argument, 0, 't' },
+	{ "rxmode",     required_argument, 0, 'x' },
+	{ "pll",        no_argument,       0, 'P' },
+	{ "votes",      required_argument, 0, 'V' },
+	{ "soft",       no_argument,       0, 'S' },
 	{ 0, 0, 0, 0 }
 };
 
-static const char *shortOpts = "vhRrpb:m:c:t:";
+static const char *shortOpts = "vhRrslapPSd:D:b:m:c:t:x:V:";
 
 static ExecutionOptions options;
 
+static volatile sig_atomic_t interrupted = 0;
+
+
+static void _onSignal(int signal) {
+	interrupted = 1;
+}
+
 
 static void _showHelp(const char *progName, const char *errorMessage) {
 	if (errorMessage != nullptr) {
@@ -119,10 +196,54 @@ static void _showHelp(const char *progName, const char *errorMessage) {
 	}
 
 	Log::reportStdOut("\nWhere:\n");
-	Log::reportStdOut("  - bitrate: 16, 32, 64\n");
+	Log::reportStdOut("  - bitrate: 16, 32, 64, shortens captures when reading\n");
 	Log::reportStdOut("  - modulation: 'manchester', 'biphase'\n");
+	Log::reportStdOut("  - rxmode: 'bitmap', 'rle', 'edge'\n");
+	Log::reportStdOut("  - device: reader key as printed by --list\n");
+	Log::reportStdOut("  - daemon: unix socket path to serve requests on\n");
+	Log::reportStdOut("  - pll: track bit period of drifting tags while reading\n");
+	Log::reportStdOut("  - soft: soft-decision decoding of captures with corrupted pulses\n");
+	Log::reportStdOut("  - votes: number of agreeing frames required to report a token (default %u)\n", rfid::TokenVoter::VOTES_DEFAULT);
+}
+
+// Decodes samples streamed by the producer thread until isDone() returns true
+static void _streamDecode(rfid::device::Interface &iface, rfid::DecoderBank &decoderBank, const std::function<bool()> &isDone) {
+	common::RingBuffer<rfid::device::Interface::Sample> ring(STREAM_RING_SIZE);
+	std::vector<rfid::device::Interface::Sample>        chunk;
+
+	std::atomic<bool> streamFinished(false);
+	std::string       streamError;
+
+	std::thread producer([&]() {
+		try {
+			iface.streamSamples(ring, isDone);
+
+		} catch (const common::Exception &ex) {
+			streamError = ex.getMessage();
+		}
+
+		streamFinished = true;
+	});
+
+	while ((! streamFinished || ! ring.isEmpty()) && ! isDone()) {
+		chunk.clear();
+
+		if (ring.pop(chunk, STREAM_CHUNK_SIZE) == 0) {
+			usleep(5 * 1000);
+			continue;
+		}
+
+		decoderBank.checkPulses(chunk);
+	}
+
+	producer.join();
+
+	if (! streamError.empty()) {
+		throw common::Exception(streamError);
+	}
 }
 
+
 int main(int argc, char *argv[]) {
 	int ret = 0;
 
@@ -144,6 +265,26 @@ int main(int argc, char *argv[]) {
 					options.read = true;
 					break;
 
+				case 's':
+					options.stream = true;
+					break;
+
+				case 'l':
+					options.list = true;
+					break;
+
+				case 'a':
+					options.readAll = true;
+					break;
+
+				case 'd':
+					options.device = optarg;
+					break;
+
+				case 'D':
+					options.daemonSocket = optarg;
+					break;
+
 				case 'p':
 					options.write = true;
 					break;
@@ -152,6 +293,21 @@ int main(int argc, char *argv[]) {
 					options.resetIface = true;
 					break;
 
+				case 'P':
+					options.pll = true;
+					break;
+
+				case 'S':
+					options.soft = true;
+					break;
+
+				case 'V':
+					options.votes = strtol(optarg, nullptr, 0);
+					if (options.votes == 0) {
+						options.showHelp = true;
+					}
+					break;
+
 				case 'b':
 					if (strcmp(optarg, "16") == 0) {
 						options.bitrate = BITRATE_16;
@@ -181,6 +337,21 @@ int main(int argc, char *argv[]) {
 					options.token = strtol(optarg, nullptr, 0);
 					break;
 
+				case 'x':
+					if (strcmp(optarg, "bitmap") == 0) {
+						options.rxMode = rfid::device::Interface::RX_MODE_BITMAP;
+
+					} else if (strcmp(optarg, "rle") == 0) {
+						options.rxMode = rfid::device::Interface::RX_MODE_RLE;
+
+					} else if (strcmp(optarg, "edge") == 0) {
+						options.rxMode = rfid::device::Interface::RX_MODE_EDGE_TIMING;
+
+					} else {
+						options.showHelp = true;
+					}
+					break;
+
 				case 'v':
 					common::Log::setLevel(common::Log::DEBUG);
 					break;
@@ -212,8 +383,71 @@ int main(int argc, char *argv[]) {
 		}
 
 		try {
+			if (options.list) {
+				for (const auto &key : rfid::device::InterfaceFactory::enumerate(rfid::device::InterfaceFactory::TYPE_USB)) {
+					Log::reportStdOut("%s\n", key.c_str());
+				}
+
+				break;
+			}
+
+			if (! options.daemonSocket.empty()) {
+				rfid::ReaderDaemon daemon(options.daemonSocket, rfid::device::InterfaceFactory::TYPE_USB, options.device, options.rxMode);
+
+				signal(SIGINT,  _onSignal);
+				signal(SIGTERM, _onSignal);
+
+				daemon.run([]() {
+					return interrupted != 0;
+				});
+
+				break;
+			}
+
+			if (options.readAll) {
+				rfid::ReaderPool   pool;
+				ReaderPoolListener listener;
+				int                readers = 0;
+
+				for (const auto &key : rfid::device::InterfaceFactory::enumerate(rfid::device::InterfaceFactory::TYPE_USB)) {
+					rfid::device::Interface *reader = rfid::device::InterfaceFactory::newInstance(rfid::device::InterfaceFactory::TYPE_USB, key);
+
+					if (! reader->isConnected()) {
+						Log::warn("Reader %s is not available", key.c_str());
+
+						delete reader;
+						continue;
+					}
+
+					reader->setRxMode(options.rxMode);
+
+					pool.addReader(reader);
+					readers++;
+				}
+
+				if (readers == 0) {
+					throw rfid::device::Interface::NotConnectedException();
+				}
+
+				Log::log("Reading from %d readers", readers);
+
+				pool.addListener(&listener);
+
+				signal(SIGINT,  _onSignal);
+				signal(SIGTERM, _onSignal);
+
+				pool.start();
+
+				while (! interrupted) {
+					usleep(100 * 1000);
+				}
+
+				pool.stop();
+				break;
+			}
+
 			iface = rfid::device::InterfaceFactory::newInstance(
-				rfid::device::InterfaceFactory::TYPE_USB
+				rfid::device::InterfaceFactory::TYPE_USB, options.device
 			);
 
 			// report version
@@ -228,73 +462,109 @@ int main(int argc, char *argv[]) {
 				break;
 			}
 
-			if (! options.read && ! options.write) {
+			if (! options.read && ! options.stream && ! options.write) {
 				_showHelp(progName, nullptr);
 				break;
 			}
 
-			if (options.read) {
-				std::shared_ptr<std::vector<rfid::device::Interface::Sample>> samples = iface->getSamples();
+			if (options.read || options.stream) {
+				rfid::DecoderBank  decoderBank;
+				rfid::TokenVoter   voter(options.votes);
+				TokenVoterListener listener;
 
-				rfid::CarrierDecoder    carrierDecoder;
-				rfid::ManchesterDecoder manchesterDecoder(&carrierDecoder);
-				rfid::BiphaseDecoder    biphaseDecoder(&carrierDecoder);
-				rfid::Em4100Decoder     em4100DecoderM(&manchesterDecoder);
-				rfid::Em4100Decoder     em4100DecoderB(&biphaseDecoder);
+				if (options.pll) {
+					decoderBank.setClockRecovery(rfid::CarrierDecoder::CLOCK_RECOVERY_PLL);
+				}
 
-				em4100DecoderM.addListener(new Em4100DecoderListener());
-				em4100DecoderB.addListener(new Em4100DecoderListener());
-				
-				carrierDecoder.checkPulses(*samples.get());
+				if (options.soft) {
+					decoderBank.setSoftDecision(true);
+				}
 
-			} else {
-				std::vector<rfid::device::Interface::Sample> samples;
+				decoderBank.addListener(&voter);
+				voter.addListener(&listener);
+
+				signal(SIGINT,  _onSignal);
+				signal(SIGTERM, _onSignal);
+
+				if (options.stream) {
+					_streamDecode(*iface, decoderBank, []() {
+						return interrupted != 0;
+					});
+
+				} else if (iface->isStreamingSupported()) {
+					// Acquisition stops as soon as enough frames agree
+					auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(READ_TIMEOUT_MS);
 
-				uint32_t em4100Eprom[2];
+					_streamDecode(*iface, decoderBank, [&voter, deadline]() {
+						return (interrupted != 0) || voter.isConfident() || (std::chrono::steady_clock::now() > deadline);
+					});
 
-				{
-					rfid::T5557Encoder::Parameters params;
+				} else {
+					std::vector<rfid::device::Interface::Sample> samples;
 
+					iface->setRxMode(options.rxMode);
+
+					// Known bitrate needs only a capture window of a few frames
 					switch (options.bitrate) {
-						case BITRATE_16: params.dataRate = rfid::T5557Encoder::DATA_RATE_16; break;
-						case BITRATE_32: params.dataRate = rfid::T5557Encoder::DATA_RATE_32; break;
-						case BITRATE_64: params.dataRate = rfid::T5557Encoder::DATA_RATE_64; break;
+						case BITRATE_16: iface->setCaptureWindow(16, rfid::device::Interface::CAPTURE_WINDOW_FRAMES); break;
+						case BITRATE_32: iface->setCaptureWindow(32, rfid::device::Interface::CAPTURE_WINDOW_FRAMES); break;
+						case BITRATE_64: iface->setCaptureWindow(64, rfid::device::Interface::CAPTURE_WINDOW_FRAMES); break;
 
 						default:
 							break;
 					}
 
-					switch (options.modulation) {
-						case MODULATION_MANCHESTER: params.modulation = rfid::T5557Encoder::MODULATION_MANCHESTER; break;
-						case MODULATION_BIPHASE:    params.modulation = rfid::T5557Encoder::MODULATION_BIPHASE;    break;
+					for (int i = 0; (i < READ_CAPTURES_MAX) && ! voter.isConfident() && ! interrupted; i++) {
+						size_t decoded = 0;
 
-						default:
-							break;
-					}
+						decoderBank.restart();
+
+						try {
+							iface->getSamples(samples, [&decoderBank, &voter, &decoded](const std::vector<rfid::device::Interface::Sample> &samples) {
+								decoderBank.checkPulses(samples.data() + decoded, samples.size() - decoded);
+
+								decoded = samples.size();
+
+								return voter.isConfident() || (interrupted != 0);
+							});
 
-					// Block 0 is a configuration block, 1 and 2 are data blocks.
-					params.maxBlock = sizeof(em4100Eprom) / sizeof(*em4100Eprom);
+						} catch (const rfid::device::Interface::TimeoutException &ex) {
+							continue;
+						}
+					}
+				}
 
-					samples.clear();
-					rfid::T5557Encoder::encodeParameters(params, false, 0, samples);
-					iface->putSamples(samples);
+				if (options.read && ! voter.isConfident()) {
+					Log::reportStdErr("No token found\n");
+					ret = -1;
 				}
 
-				{
-					rfid::Em4100Eprom::generate(em4100Eprom, options.customerId, options.token);
+			} else {
+				rfid::T5557Encoder::DataRate   dataRate   = rfid::T5557Encoder::DATA_RATE_16;
+				rfid::T5557Encoder::Modulation modulation = rfid::T5557Encoder::MODULATION_MANCHESTER;
 
-					samples.clear();
-					rfid::T5557Encoder::encodeBlock(0, 1, false, false, 0, em4100Eprom[0], samples);
-					iface->putSamples(samples);
+				switch (options.bitrate) {
+					case BITRATE_16: dataRate = rfid::T5557Encoder::DATA_RATE_16; break;
+					case BITRATE_32: dataRate = rfid::T5557Encoder::DATA_RATE_32; break;
+					case BITRATE_64: dataRate = rfid::T5557Encoder::DATA_RATE_64; break;
 
-					samples.clear();
-					rfid::T5557Encoder::encodeBlock(0, 2, false, false, 0, em4100Eprom[1], samples);
-					iface->putSamples(samples);
+					default:
+						break;
 				}
+
+				switch (options.modulation) {
+					case MODULATION_MANCHESTER: modulation = rfid::T5557Encoder::MODULATION_MANCHESTER; break;
+					case MODULATION_BIPHASE:    modulation = rfid::T5557Encoder::MODULATION_BIPHASE;    break;
+
+					default:
+						break;
+				}
+
+				rfid::Em4100Writer::write(*iface, dataRate, modulation, options.customerId, options.token);
 			}
 
 		} catch (const common::Exception &ex) {
-			Log::reportStdErr(ex.getMessage() + "\n");
+			Log::reportStdErr("%s\n", ex.getMessage().c_str());
 			ret = -1;
 
 		} catch (...) {
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+
+#include "rfid/BitmapDecoder.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+	#define BITMAP_DECODER_AVX2 1
+
+	#include <immintrin.h>
+#endif
+
+using Sample = rfid::device::Interface::Sample;
+
+
+static inline uint64_t _load64(const uint8_t *buffer) {
+	uint64_t ret;
+
+	memcpy(&ret, buffer, sizeof(ret));
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	ret = __builtin_bswap64(ret);
+#endif
+
+	return ret;
+}
+
+
+// Loads less than 8 bytes, missing bits are zeroed
+static inline uint64_t _loadTail(const uint8_t *buffer, size_t bufferSize) {
+	uint64_t ret = 0;
+
+	for (size_t i = 0; i < bufferSize; i++) {
+		ret |= (uint64_t) buffer[i] << (i * 8);
+	}
+
+	return ret;
+}
+
+
+// Bit n of the result is set when sample n differs from sample n - 1
+static inline uint64_t _transitions(uint64_t word, uint64_t prevBit) {
+	return word ^ ((word << 1) | prevBit);
+}
+
+
+static inline void _emit(uint64_t transitions, unsigned bits, int &level, uint32_t &runLength, uint16_t prescaler, Sample *samples, size_t samplesCapacity, size_t &samplesCount) {
+	unsigned last = 0;
+
+	while (transitions != 0) {
+		unsigned pos = __builtin_ctzll(transitions);
+
+		transitions &= transitions - 1;
+
+		if (samplesCount < samplesCapacity) {
+			uint64_t carriers = (uint64_t) (runLength + pos - last) * prescaler;
+
+			// Set bit means low level on the demodulator output
+			samples[samplesCount] = Sample::fromCarriers(carriers > Sample::LENGTH_MASK ? Sample::LENGTH_MASK : carriers, level == 0);
+		}
+
+		samplesCount++;
+
+		level     ^= 1;
+		runLength  = 0;
+		last       = pos;
+	}
+
+	runLength += bits - last;
+}
+
+
+#ifdef BITMAP_DECODER_AVX2
+// Transitions of four consecutive words, prevBit is the last sample before the block
+__attribute__((target("avx2")))
+static inline __m256i _transitionsAvx2(const uint8_t *buffer, uint64_t prevBit) {
+	__m256i word  = _mm256_loadu_si256((const __m256i *) buffer);
+	__m256i prev  = _mm256_permute4x64_epi64(word, _MM_SHUFFLE(2, 1, 0, 0));
+	__m256i carry = _mm256_blend_epi32(_mm256_srli_epi64(prev, 63), _mm256_set_epi64x(0, 0, 0, prevBit), 0x03);
+
+	return _mm256_xor_si256(word, _mm256_or_si256(_mm256_slli_epi64(word, 1), carry));
+}
+
+
+// Popcount of the transitions using nibble lookup, returns number of transitions
+__attribute__((target("avx2")))
+static size_t _countAvx2(const uint8_t *buffer, size_t blocks, uint64_t &prevBit) {
+	const __m256i lut = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+	);
+	const __m256i lowNibble = _mm256_set1_epi8(0x0f);
+
+	__m256i acc = _mm256_setzero_si256();
+
+	for (size_t i = 0; i < blocks; i++) {
+		__m256i transitions = _transitionsAvx2(buffer + i * 32, prevBit);
+		__m256i counts      = _mm256_add_epi8(
+			_mm256_shuffle_epi8(lut, _mm256_and_si256(transitions, lowNibble)),
+			_mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(transitions, 4), lowNibble))
+		);
+
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+
+		prevBit = _load64(buffer + i * 32 + 24) >> 63;
+	}
+
+	return _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1) + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+}
+#endif
+
+
+rfid::device::BitmapDecoder::BitmapDecoder(uint16_t prescaler) {
+	this->prescaler = prescaler;
+	this->kernel    = getBestKernel();
+
+	this->reset();
+}
+
+
+void rfid::device::BitmapDecoder::reset() {
+	this->level     = -1;
+	this->runLength = 0;
+}
+
+
+rfid::device::BitmapDecoder::Kernel rfid::device::BitmapDecoder::getBestKernel() {
+#ifdef BITMAP_DECODER_AVX2
+	if (__builtin_cpu_supports("avx2")) {
+		return KERNEL_AVX2;
+	}
+#endif
+
+	return KERNEL_WORD;
+}
+
+
+void rfid::device::BitmapDecoder::setKernel(Kernel kernel) {
+	this->kernel = (kernel == KERNEL_AVX2) ? getBestKernel() : kernel;
+}
+
+
+size_t rfid::device::BitmapDecoder::countTransitions(const uint8_t *buffer, size_t bufferSize) const {
+	size_t   ret     = 0;
+	size_t   offset  = 0;
+	uint64_t prevBit = (this->level < 0) ? (buffer[0] & 1) : this->level;
+
+#ifdef BITMAP_DECODER_AVX2
+	if (this->kernel == KERNEL_AVX2) {
+		ret    += _countAvx2(buffer, bufferSize / 32, prevBit);
+		offset += (bufferSize / 32) * 32;
+	}
+#endif
+
+	for (; offset + 8 <= bufferSize; offset += 8) {
+		uint64_t word = _load64(buffer + offset);
+
+		ret += __builtin_popcountll(_transitions(word, prevBit));
+
+		prevBit = word >> 63;
+	}
+
+	if (offset < bufferSize) {
+		unsigned bits = (bufferSize - offset) * 8;
+
+		ret += __builtin_popcountll(_transitions(_loadTail(buffer + offset, bufferSize - offset), prevBit) & ((((uint64_t) 1) << bits) - 1));
+	}
+
+	return ret;
+}
+
+
+size_t rfid::device::BitmapDecoder::decode(const uint8_t *buffer, size_t bufferSize, Interface::Sample *samples, size_t samplesCapacity) {
+	size_t samplesCount = 0;
+	size_t offset       = 0;
+
+	if (bufferSize == 0) {
+		return 0;
+	}
+
+	if (this->level < 0) {
+		this->level     = buffer[0] & 1;
+		this->runLength = 0;
+	}
+
+	// Emitting is bound by the serial ctz loop, AVX2 does not pay off here
+	for (; offset + 8 <= bufferSize; offset += 8) {
+		_emit(_transitions(_load64(buffer + offset), this->level), 64, this->level, this->runLength, this->prescaler, samples, samplesCapacity, samplesCount);
+	}
+
+	if (offset < bufferSize) {
+		unsigned bits        = (bufferSize - offset) * 8;
+		uint64_t transitions = _transitions(_loadTail(buffer + offset, bufferSize - offset), this->level) & ((((uint64_t) 1) << bits) - 1);
+
+		_emit(transitions, bits, this->level, this->runLength, this->prescaler, samples, samplesCapacity, samplesCount);
+	}
+
+	return samplesCount;
+}
+
+
+void rfid::device::BitmapDecoder::decode(const uint8_t *buffer, size_t bufferSize, std::vector<Interface::Sample> &samples) {
+	size_t offset = samples.size();
+
+	if (bufferSize == 0) {
+		return;
+	}
+
+	samples.resize(offset + this->countTransitions(buffer, bufferSize));
+
+	this->decode(buffer, bufferSize, samples.data() + offset, samples.size() - offset);
+}
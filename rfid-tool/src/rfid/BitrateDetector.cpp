@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rfid/BitrateDetector.hpp"
+
+#include "common/Log.hpp"
+
+// Longest pulse of the slowest rate with tolerance fits in
+#define HISTOGRAM_SIZE 256
+
+#define PULSES_MIN 32
+
+// Both clusters have to hold at least 1/16 of pulses and together at least 80% of them
+#define CLUSTER_SHARE_MIN 16
+#define MATCHED_PERCENT   80
+
+
+const uint8_t rfid::BitrateDetector::CARRIER_DIVIDERS[8] = { 8, 16, 32, 40, 50, 64, 100, 128 };
+
+
+static uint16_t _gcd(uint16_t a, uint16_t b) {
+	while (b != 0) {
+		uint16_t tmp = a % b;
+
+		a = b;
+		b = tmp;
+	}
+
+	return a;
+}
+
+
+bool rfid::BitrateDetector::detect(const rfid::device::Interface::Sample *samples, size_t samplesCount, Result &result) {
+	uint32_t histogram[HISTOGRAM_SIZE] = { 0 };
+	uint32_t total   = 0;
+	uint16_t quantum = 0;
+
+	double bestCost = 0;
+	bool   found    = false;
+
+	for (size_t i = 0; i < samplesCount; i++) {
+		uint16_t length = samples[i].getLengthCarriers();
+
+		if (length == 0) {
+			continue;
+		}
+
+		// Sampler resolution, captured lengths are multiples of the prescaler
+		quantum = _gcd(quantum, length);
+
+		if (length < HISTOGRAM_SIZE) {
+			histogram[length]++;
+		}
+
+		total++;
+	}
+
+	if (total < PULSES_MIN) {
+		return false;
+	}
+
+	for (uint8_t carrierDivider : CARRIER_DIVIDERS) {
+		uint16_t shortCenter = carrierDivider / 2;
+		uint16_t longCenter  = carrierDivider;
+		uint16_t tolerance   = carrierDivider / 8;
+
+		uint32_t shortCount = 0;
+		uint32_t longCount  = 0;
+		uint64_t error      = 0;
+
+		// Pulse length is known with sampler resolution only, but windows can not overlap
+		if (tolerance < quantum) {
+			tolerance = quantum;
+		}
+
+		if (tolerance > carrierDivider / 4 - 1) {
+			tolerance = carrierDivider / 4 - 1;
+		}
+
+		for (uint16_t length = shortCenter - tolerance; length <= longCenter + tolerance; length++) {
+			if (length <= shortCenter + tolerance) {
+				shortCount += histogram[length];
+				error      += (uint64_t) histogram[length] * (length > shortCenter ? length - shortCenter : shortCenter - length);
+
+			} else if (length >= longCenter - tolerance) {
+				longCount += histogram[length];
+				error     += (uint64_t) histogram[length] * (length > longCenter ? length - longCenter : longCenter - length);
+			}
+		}
+
+		if (
+			(shortCount * CLUSTER_SHARE_MIN < total) ||
+			(longCount  * CLUSTER_SHARE_MIN < total) ||
+			((shortCount + longCount) * 100 < total * MATCHED_PERCENT)
+		) {
+			continue;
+		}
+
+		{
+			// Mean distance from cluster centers, relative to the bit period
+			double cost = (double) error / (shortCount + longCount) / carrierDivider;
+
+			common::Log::debug("RF/%u: short %u, long %u, total %u, cost %.3f", carrierDivider, shortCount, longCount, total, cost);
+
+			if (! found || (cost < bestCost)) {
+				found    = true;
+				bestCost = cost;
+
+				result.carrierDivider = carrierDivider;
+				result.tolerance      = tolerance;
+			}
+		}
+	}
+
+	return found;
+}
@@ -16,156 +16,200 @@
  */
 
 #include "rfid/CarrierDecoder.hpp"
+#include "rfid/BitrateDetector.hpp"
 #include "common/Log.hpp"
 
-#define CARRIER_PULSE_LENGTH 8 // us
+// Half bit period fraction bits
+#define PERIOD_SHIFT   8
+// Loop filter gain: 1/16 of the period error per pulse
+#define PLL_GAIN_SHIFT 4
 
-#define PULSE_MAX      50
-#define ERROR_TRESHOLD 10 // 20%
 
-#define PULSE_SHORT(__dec, __pulse) ((__pulse >= __dec->shortMin) && (__pulse <= __dec->shortMax))
-#define PULSE_LONG(__dec, __pulse) ((__pulse >= __dec->longMin) && (__pulse <= __dec->longMax))
+const size_t rfid::CarrierDecoder::CLASSIFY_BLOCK;
 
 
 void rfid::CarrierDecoder::updatePulseRange() {
-	uint16_t pulseLength = (this->carrierDivider * CARRIER_PULSE_LENGTH) / 2;
-	uint16_t delta       = pulseLength >> 2; // 25%
+	uint16_t pulseLength = (this->halfPeriod + (1 << (PERIOD_SHIFT - 1))) >> PERIOD_SHIFT;
+	uint16_t delta;
+	uint16_t shortMin;
+	uint16_t shortMax;
+	uint16_t longMin;
+	uint16_t longMax;
 
-	this->shortMin = pulseLength - delta;
-	this->shortMax = pulseLength + delta;
+	if (this->tolerance) {
+		delta = this->tolerance;
 
-	pulseLength <<= 1;
+	} else if (this->clockRecovery == CLOCK_RECOVERY_PLL) {
+		delta = (pulseLength * 3) >> 3; // 37.5%, ranges stay centered on tracked period
 
-	this->longMin = pulseLength - delta;
-	this->longMax = pulseLength + delta;
-}
+	} else {
+		delta = pulseLength >> 2; // 25%
+	}
 
-rfid::CarrierDecoder::CarrierDecoder() {
-	this->reset();
-}
+	shortMin = pulseLength - delta;
+	shortMax = pulseLength + delta;
 
+	pulseLength = (2 * this->halfPeriod + (1 << (PERIOD_SHIFT - 1))) >> PERIOD_SHIFT;
 
-rfid::CarrierDecoder::~CarrierDecoder() {
+	longMin = pulseLength - delta;
+	longMax = pulseLength + delta;
 
-}
+	// Tracked period moves the ranges rarely, classified pulses stay valid until then
+	if ((shortMin == this->shortMin) && (shortMax == this->shortMax) && (longMin == this->longMin) && (longMax == this->longMax)) {
+		return;
+	}
 
+	this->shortMin = shortMin;
+	this->shortMax = shortMax;
+	this->longMin  = longMin;
+	this->longMax  = longMax;
 
-void rfid::CarrierDecoder::reset() {
-	this->carrierDivider = 16;
-	this->errorCount     = 0;
-	this->pulseCount     = 0;
-	this->hasSync        = false;
+	this->rangeChanged = true;
+}
 
-	this->loCount = 0;
-	this->hiCount = 0;
+
+void rfid::CarrierDecoder::resetPeriod() {
+	this->halfPeriod = (uint32_t) this->carrierDivider << (PERIOD_SHIFT - 1);
 
 	this->updatePulseRange();
 }
 
 
-void rfid::CarrierDecoder::checkPulses(const std::vector<rfid::device::Interface::Sample> &samples) {
-	for (const auto &sample : samples) {
-		bool nextCarrier = false;
+void rfid::CarrierDecoder::trackPeriod(uint16_t pulseLength) {
+	int32_t nominal = (int32_t) this->carrierDivider << (PERIOD_SHIFT - 1);
+	int32_t period  = this->halfPeriod;
+	int32_t length  = (int32_t) pulseLength << PERIOD_SHIFT;
+	int32_t error;
 
-		this->pulseCount++;
+	// Capture range is wider than pulse ranges, off-nominal pulses pull the period too
+	if ((length < period / 2) || (length > period * 5 / 2)) {
+		return;
 
-		// Handle error
-		if (this->errorCount >= ERROR_TRESHOLD) {
-			common::Log::debug("next carrier! error count: %u, loCount: %u, hiCount: %u, pulseCount: %u, divider: %u",
-				this->errorCount, this->loCount, this->hiCount, this->pulseCount, this->carrierDivider
-			);
+	} else if (length < period * 3 / 2) {
+		error = length - period;
 
-			nextCarrier = true;
+	} else {
+		error = (length - 2 * period) / 2;
+	}
 
-		} else if (this->pulseCount == PULSE_MAX) {
-			// Next loop
-			this->pulseCount = 0;
-			this->errorCount = 0;
-		}
+	period += error / (1 << PLL_GAIN_SHIFT);
 
-		if (nextCarrier) {
-			this->hasSync    = false;
-			this->loCount    = 0;
-			this->hiCount    = 0;
-			this->errorCount = 0;
-			this->pulseCount = 0;
+	// Do not walk away to the neighbour data rate
+	if (period > nominal + nominal / 5) {
+		period = nominal + nominal / 5;
 
-			{
-				EventSyncData data;
+	} else if (period < nominal - nominal / 5) {
+		period = nominal - nominal / 5;
+	}
 
-				data.hasSync        = this->hasSync;
-				data.carrierDivider = 0;
+	if ((uint32_t) period != this->halfPeriod) {
+		this->halfPeriod = period;
 
-				this->notify(EVENT_SYNC_CHANGED, &data);
-			}
+		this->updatePulseRange();
+	}
+}
 
-			switch (this->carrierDivider) {
-				case 16: this->carrierDivider = 32; break;
-				case 32: this->carrierDivider = 64; break;
-				case 64: this->carrierDivider = 16; break;
-			}
 
-			this->updatePulseRange();
+rfid::CarrierDecoder::CarrierDecoder() {
+	this->fixedDivider  = 0;
+	this->tolerance     = 0;
+	this->clockRecovery = CLOCK_RECOVERY_NONE;
+
+	this->shortMin     = 0;
+	this->shortMax     = 0;
+	this->longMin      = 0;
+	this->longMax      = 0;
+	this->rangeChanged = false;
+
+	this->reset();
+}
+
 
-		} else {
-			// NO_SYNC -> SYNC
-			if (! this->hasSync) {
-				if (PULSE_SHORT(this, sample.getLengthUs())) {
-					this->loCount++;
+rfid::CarrierDecoder::CarrierDecoder(uint8_t fixedDivider) {
+	this->fixedDivider  = fixedDivider;
+	this->tolerance     = 0;
+	this->clockRecovery = CLOCK_RECOVERY_NONE;
 
-				} else if (PULSE_LONG(this, sample.getLengthUs())) {
-					this->hiCount++;
+	this->shortMin     = 0;
+	this->shortMax     = 0;
+	this->longMin      = 0;
+	this->longMax      = 0;
+	this->rangeChanged = false;
 
-				} else {
-					//common::Log::debug("Out of sync, bad pulse: %uus, (short %uus - %uus, long %uus - %uus)",
-					//	sample.getLengthUs(), this->shortMin, this->shortMax, this->longMin, this->longMax
-					//);
+	this->reset();
+}
 
-					this->errorCount++;
-				}
 
-				if (this->hiCount > 4 && this->loCount > 4 && this->errorCount < 4) {
-					this->hasSync = true;
+rfid::CarrierDecoder::~CarrierDecoder() {
 
-					{
-						EventSyncData data;
+}
 
-						data.hasSync        = this->hasSync;
-						data.carrierDivider = this->carrierDivider;
 
-						this->notify(EVENT_SYNC_CHANGED, &data);
-					}
-				}
+void rfid::CarrierDecoder::reset() {
+	this->carrierDivider = this->fixedDivider ? this->fixedDivider : 16;
+	this->errorCount     = 0;
+	this->pulseCount     = 0;
+	this->hasSync        = false;
 
-			} else {
-				EventPulseData data;
+	this->loCount = 0;
+	this->hiCount = 0;
 
-				data.isHigh = ! sample.isLow();
+	this->resetPeriod();
+}
 
-				if (PULSE_LONG(this, sample.getLengthUs())) {
-					data.isLong = true;
 
-					this->notify(EVENT_NEW_PULSE, &data);
+void rfid::CarrierDecoder::setClockRecovery(ClockRecovery clockRecovery) {
+	this->clockRecovery = clockRecovery;
 
-				} else if (PULSE_SHORT(this, sample.getLengthUs())) {
-					data.isLong = false;
+	this->resetPeriod();
+}
 
-					this->notify(EVENT_NEW_PULSE, &data);
 
-				} else {
-					//common::Log::debug("In sync, bad pulse: %uus, (short %uus - %uus, long %uus - %uus)",
-					//	sample.getLengthUs(), this->shortMin, this->shortMax, this->longMin, this->longMax
-					//);
+void rfid::CarrierDecoder::setCarrierDivider(uint8_t carrierDivider, uint8_t tolerance) {
+	// Keep sync when only the tolerance changes
+	if ((carrierDivider != 0) && (carrierDivider == this->carrierDivider) && (carrierDivider == this->fixedDivider)) {
+		this->tolerance = tolerance;
 
-					this->errorCount++;
-				}
+		this->resetPeriod();
+
+	} else {
+		this->fixedDivider = carrierDivider;
+		this->tolerance    = tolerance;
+
+		this->reset();
+	}
+}
+
+
+void rfid::CarrierDecoder::nextCarrierDivider() {
+	if (! this->fixedDivider) {
+		const size_t dividersCount = sizeof(BitrateDetector::CARRIER_DIVIDERS) / sizeof(BitrateDetector::CARRIER_DIVIDERS[0]);
+
+		for (size_t i = 0; i < dividersCount; i++) {
+			if (BitrateDetector::CARRIER_DIVIDERS[i] == this->carrierDivider) {
+				this->carrierDivider = BitrateDetector::CARRIER_DIVIDERS[(i + 1) % dividersCount];
+				break;
 			}
 		}
+	}
+
+	this->resetPeriod();
+}
+
+
+void rfid::CarrierDecoder::checkPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount) {
+	NotifierSink sink(*this);
+
+	for (size_t i = 0; i < samplesCount; i++) {
+		this->checkPulse(samples[i], sink);
+	}
+}
+
+
+void rfid::CarrierDecoder::checkPulses(const rfid::device::SampleArray &samples) {
+	NotifierSink sink(*this);
 
-//		common::Log::debug("sync: %u, divider: %u, short %u - %u, long: %u - %u, errors: %u, pulses: %u, hi: %u, lo: %u",
-//			this->hasSync, this->carrierDivider, this->shortMin, this->shortMax,
-//			this->longMin, this->longMax, this->errorCount, this->pulseCount,
-//			this->hiCount, this->loCount
-//		);
+	for (size_t i = 0; i < samples.size(); i++) {
+		this->checkPulse(samples[i], sink);
 	}
 }
@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "rfid/DecoderBank.hpp"
+#include "rfid/BitrateDetector.hpp"
+#include "common/Log.hpp"
+
+// Samples of a fragment kept for the next call. Frame spans at most 128 pulses, the rest gives
+// the soft decision search some context.
+#define SOFT_CARRY_SAMPLES 256
+
+
+rfid::DecoderBank::Hypothesis::Hypothesis(DecoderBank &bank, uint8_t carrierDivider) :
+	bank(bank),
+	carrierDecoder(carrierDivider),
+	manchesterDecoder(&carrierDecoder),
+	biphaseDecoder(&carrierDecoder),
+	em4100DecoderM(&manchesterDecoder),
+	em4100DecoderB(&biphaseDecoder),
+	sink(*this),
+	classified(false)
+{
+}
+
+
+rfid::DecoderBank::DecoderBank() :
+	softDecoderM(0, SoftDecoder::CODING_MANCHESTER),
+	softDecoderB(0, SoftDecoder::CODING_BIPHASE)
+{
+	this->init(std::vector<uint8_t>(
+		BitrateDetector::CARRIER_DIVIDERS,
+		BitrateDetector::CARRIER_DIVIDERS + sizeof(BitrateDetector::CARRIER_DIVIDERS) / sizeof(BitrateDetector::CARRIER_DIVIDERS[0])
+	));
+}
+
+
+rfid::DecoderBank::DecoderBank(const std::vector<uint8_t> &carrierDividers) :
+	softDecoderM(0, SoftDecoder::CODING_MANCHESTER),
+	softDecoderB(0, SoftDecoder::CODING_BIPHASE)
+{
+	this->init(carrierDividers);
+}
+
+
+rfid::DecoderBank::~DecoderBank() {
+}
+
+
+void rfid::DecoderBank::init(const std::vector<uint8_t> &carrierDividers) {
+	this->winner        = nullptr;
+	this->winnerDecoder = nullptr;
+	this->detected      = nullptr;
+	this->softDecision  = false;
+	this->tokenFound    = false;
+
+	for (uint8_t carrierDivider : carrierDividers) {
+		this->hypotheses.push_back(std::unique_ptr<Hypothesis>(new Hypothesis(*this, carrierDivider)));
+	}
+}
+
+
+void rfid::DecoderBank::reset() {
+	this->winner        = nullptr;
+	this->winnerDecoder = nullptr;
+	this->detected      = nullptr;
+
+	this->softSamples.clear();
+
+	for (auto &hypothesis : this->hypotheses) {
+		hypothesis->carrierDecoder.reset();
+		hypothesis->manchesterDecoder.reset();
+		hypothesis->biphaseDecoder.reset();
+		hypothesis->em4100DecoderM.reset();
+		hypothesis->em4100DecoderB.reset();
+	}
+}
+
+
+void rfid::DecoderBank::restart() {
+	static const rfid::device::Interface::Sample gap;
+
+	this->checkPulses(&gap, 1);
+}
+
+
+void rfid::DecoderBank::setClockRecovery(CarrierDecoder::ClockRecovery clockRecovery) {
+	for (auto &hypothesis : this->hypotheses) {
+		hypothesis->carrierDecoder.setClockRecovery(clockRecovery);
+	}
+}
+
+
+void rfid::DecoderBank::setSoftDecision(bool enabled) {
+	this->softDecision = enabled;
+}
+
+
+inline void rfid::DecoderBank::checkPulses(Hypothesis &hypothesis, const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t start, size_t end) {
+	// Rest of the block is classified when the hypothesis is fed for the first time
+	if (! hypothesis.classified) {
+		hypothesis.carrierDecoder.classifyBlock(samples + start, samplesCount - start, hypothesis.pulseClasses + start);
+		hypothesis.classified = true;
+	}
+
+	hypothesis.carrierDecoder.checkPulses(samples, samplesCount, start, end, hypothesis.pulseClasses, hypothesis.sink);
+}
+
+
+void rfid::DecoderBank::checkPulses(const rfid::device::Interface::Sample *samples, size_t samplesCount) {
+	bool detect = true;
+
+	this->tokenFound = false;
+
+	for (size_t block = 0; block < samplesCount; block += CarrierDecoder::CLASSIFY_BLOCK) {
+		const rfid::device::Interface::Sample *blockSamples = samples + block;
+
+		size_t blockSize = std::min(CarrierDecoder::CLASSIFY_BLOCK, samplesCount - block);
+
+		for (auto &hypothesis : this->hypotheses) {
+			hypothesis->classified = false;
+		}
+
+		for (size_t i = 0; i < blockSize; i++) {
+			// Signal was lost, the next token may come from any hypothesis
+			if (blockSamples[i].isGap()) {
+				this->winner        = nullptr;
+				this->winnerDecoder = nullptr;
+				this->detected      = nullptr;
+
+				// Partial frames do not continue after the gap
+				for (auto &hypothesis : this->hypotheses) {
+					hypothesis->em4100DecoderM.reset();
+					hypothesis->em4100DecoderB.reset();
+				}
+
+				detect = true;
+
+			} else if (detect) {
+				if ((this->winner == nullptr) && (this->detected == nullptr)) {
+					this->detect(&blockSamples[i], samplesCount - block - i);
+				}
+
+				detect = false;
+			}
+
+			if ((this->winner != nullptr) || (this->detected != nullptr)) {
+				Hypothesis *hypothesis = (this->winner != nullptr) ? this->winner : this->detected;
+
+				size_t end = i + 1;
+
+				// Single hypothesis is fed till the next gap
+				while ((end < blockSize) && ! blockSamples[end].isGap()) {
+					end++;
+				}
+
+				this->checkPulses(*hypothesis, blockSamples, blockSize, i, end);
+
+				i = end - 1;
+
+			} else {
+				// Hunting hypotheses switch dividers every few pulses on noise, classes of a block
+				// would not outlive the switch
+				for (auto &hypothesis : this->hypotheses) {
+					hypothesis->carrierDecoder.checkPulse(blockSamples[i], hypothesis->sink);
+
+					if (this->winner != nullptr) {
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	if (this->softDecision) {
+		this->softDecode(samples, samplesCount);
+	}
+}
+
+
+void rfid::DecoderBank::detect(const rfid::device::Interface::Sample *samples, size_t samplesCount) {
+	BitrateDetector::Result result;
+
+	// Detect on continuous fragment only
+	for (size_t i = 0; i < samplesCount; i++) {
+		if (samples[i].isGap()) {
+			samplesCount = i;
+			break;
+		}
+	}
+
+	if (! BitrateDetector::detect(samples, samplesCount, result)) {
+		return;
+	}
+
+	for (auto &hypothesis : this->hypotheses) {
+		if (hypothesis->carrierDecoder.getCarrierDivider() == result.carrierDivider) {
+			common::Log::debug("Detected RF/%u, tolerance %u", result.carrierDivider, result.tolerance);
+
+			hypothesis->carrierDecoder.setCarrierDivider(result.carrierDivider, result.tolerance);
+
+			this->detected = hypothesis.get();
+			break;
+		}
+	}
+}
+
+
+void rfid::DecoderBank::softDecode(const rfid::device::Interface::Sample *samples, size_t samplesCount) {
+	// Samples carried over from the previous call precede the new ones
+	size_t carried = this->softSamples.size();
+	size_t start   = 0;
+	// Hard decision already succeeded, samples are only kept
+	bool   decoded = this->tokenFound;
+
+	this->softSamples.insert(this->softSamples.end(), samples, samples + samplesCount);
+
+	samples      = this->softSamples.data();
+	samplesCount = this->softSamples.size();
+
+	for (size_t i = 0; (i <= samplesCount) && ! decoded; i++) {
+		if ((i == samplesCount) || samples[i].isGap()) {
+			BitrateDetector::Result result;
+
+			if ((i > start) && (i > carried) && BitrateDetector::detect(samples + start, i - start, result)) {
+				for (auto &hypothesis : this->hypotheses) {
+					if (hypothesis->carrierDecoder.getCarrierDivider() == result.carrierDivider) {
+						SoftSink sinkM(*this, *hypothesis, MODULATION_MANCHESTER);
+						SoftSink sinkB(*this, *hypothesis, MODULATION_BIPHASE);
+
+						this->softDecoderM.setCarrierDivider(result.carrierDivider);
+						this->softDecoderB.setCarrierDivider(result.carrierDivider);
+
+						this->softDecoderM.decode(samples + start, i - start, (carried > start) ? carried - start : 0, sinkM);
+						this->softDecoderB.decode(samples + start, i - start, (carried > start) ? carried - start : 0, sinkB);
+						break;
+					}
+				}
+			}
+
+			start = i + 1;
+		}
+	}
+
+	// The last fragment may continue in the next call
+	for (start = samplesCount; (start > 0) && ! samples[start - 1].isGap(); start--);
+
+	if (samplesCount - start > SOFT_CARRY_SAMPLES) {
+		start = samplesCount - SOFT_CARRY_SAMPLES;
+	}
+
+	this->softSamples.erase(this->softSamples.begin(), this->softSamples.begin() + start);
+}
+
+
+void rfid::DecoderBank::onToken(Hypothesis &hypothesis, Em4100Decoder &decoder, Em4100Decoder::EventNewTokenData &token) {
+	if (this->winner == nullptr) {
+		this->winner        = &hypothesis;
+		this->winnerDecoder = &decoder;
+
+	} else if (&decoder != this->winnerDecoder) {
+		return;
+	}
+
+	this->notifyToken(hypothesis, (&decoder == &hypothesis.em4100DecoderB) ? MODULATION_BIPHASE : MODULATION_MANCHESTER, token);
+}
+
+
+void rfid::DecoderBank::notifyToken(Hypothesis &hypothesis, Modulation modulation, Em4100Decoder::EventNewTokenData &token) {
+	EventNewTokenData data;
+
+	this->tokenFound = true;
+
+	data.carrierDivider      = hypothesis.carrierDecoder.getCarrierDivider();
+	data.modulation          = modulation;
+	data.data                = token.data;
+	data.versionOrCustomerId = token.versionOrCustomerId;
+
+	if (modulation == MODULATION_BIPHASE) {
+		data.codingDecoder = &hypothesis.biphaseDecoder;
+
+	} else {
+		data.codingDecoder = &hypothesis.manchesterDecoder;
+	}
+
+	this->notify(EVENT_NEW_TOKEN, &data);
+}
@@ -17,12 +17,8 @@
 
 #include <cstdint>
 
-#include "common/DataUtils.hpp"
-
 #include "rfid/Em4100Decoder.hpp"
 
-#include "common/Log.hpp"
-
 
 rfid::Em4100Decoder::Em4100Decoder(CodingDecoder *codingDecoder) : codingDecoder(codingDecoder) {
 	this->reset();
@@ -37,110 +33,65 @@ rfid::Em4100Decoder::~Em4100Decoder() {
 
 
 void rfid::Em4100Decoder::reset() {
-	this->state    = DECODER_STATE_PREAMBLE;
+	this->window   = 0;
 	this->bitCount = 0;
-	this->nibble   = 0;
 }
 
 
 void rfid::Em4100Decoder::onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
 	if (eventId == rfid::CodingDecoder::EVENT_NEW_BIT) {
-		CodingDecoder::EventBitData *data = reinterpret_cast<CodingDecoder::EventBitData *>(eventData);
-
-//		common::Log::debug("BIT: %u", data->isOne);
-
-		switch (this->state) {
-			case DECODER_STATE_PREAMBLE:
-				{
-//					common::Log::debug("PREAMBLE");
-
-					if (data->isOne) {
-						this->bitCount++;
-						if (this->bitCount == 9) {
-							this->state    = DECODER_STATE_DATA;
-							this->bitCount = 0;
-
-							this->nibbleCount = 0;
-							this->nibbleLen   = 0;
-						}
-
-					} else {
-						this->bitCount = 0;
-					}
-				}
-				break;
-
-			case DECODER_STATE_DATA:
-				{
-//					common::Log::debug("DATA");
-
-					if (this->nibbleLen == 4) {
-						bool parityOk;
-
-						if (this->nibbleCount == 10) {
-							parityOk = ! data->isOne; // Stop bit
-
-						} else {
-							parityOk = common::DataUtils::parityNibble(this->nibble) == data->isOne;
-						}
+		NotifierSink sink(*this);
 
-						if (parityOk) {
-							uint8_t byteNo = this->nibbleCount >> 1;
-							uint8_t byteHi = this->nibbleCount & 1;
-
-							if (! byteHi) {
-								this->data[byteNo] = 0;
-							}
-
-							this->data[byteNo] |= (this->nibble << (byteHi ? 0 : 4));
+		this->decodeBit(reinterpret_cast<CodingDecoder::EventBitData *>(eventData)->isOne, sink);
+	}
+}
 
-							this->nibbleLen = 0;
-							this->nibbleCount++;
 
-							if (this->nibbleCount == 11) {
-								uint8_t colsParity = 0;
+bool rfid::Em4100Decoder::correctFrame(uint64_t frame, uint64_t suspectMask, uint64_t &corrected) {
+	uint64_t rows;
+	uint64_t cols;
+	uint64_t fold;
+	uint64_t error;
 
-								for (uint8_t i = 0; i < 5; i++) {
-									colsParity ^= this->data[i] & 0xf0;
-									colsParity ^= this->data[i] << 4;
-								}
+	if ((frame >> 55) != HEADER || (frame & STOP_BIT_MASK)) {
+		return false;
+	}
 
-								if (colsParity != this->data[5]) {
-									common::Log::error("Cols parity has failed!");
+	fold = frame ^ (frame >> 1) ^ (frame >> 2) ^ (frame >> 3) ^ (frame >> 4);
+	rows = fold & ROW_PARITY_MASK;
 
-								} else {
-									EventNewTokenData eventData;
+	fold  = frame & FRAME_DATA_MASK;
+	fold ^= fold >> 5;
+	fold ^= fold >> 10;
+	fold ^= fold >> 20;
+	fold ^= fold >> 40;
+	cols  = fold & COL_PARITY_MASK;
 
-									eventData.versionOrCustomerId = this->data[0];
+	// Single error breaks at most one row and one column
+	if (((rows | cols) == 0) || (rows & (rows - 1)) || (cols & (cols - 1))) {
+		return false;
+	}
 
-									eventData.data  = this->data[1]; eventData.data <<= 8;
-									eventData.data |= this->data[2]; eventData.data <<= 8;
-									eventData.data |= this->data[3]; eventData.data <<= 8;
-									eventData.data |= this->data[4];
+	if (rows && cols) {
+		// Data bit lies left of its row parity bit, by column parity bit position
+		error = rows;
 
-									this->notify(EVENT_NEW_TOKEN, &eventData);
-								}
+		while (cols >>= 1) {
+			error <<= 1;
+		}
 
-								this->state = DECODER_STATE_PREAMBLE;
-							}
+	} else {
+		// Row or column parity bit itself
+		error = rows | cols;
+	}
 
-						} else {
-							common::Log::error("Parity not OK!");
+	if ((error & suspectMask) == 0) {
+		return false;
+	}
 
-							this->state = DECODER_STATE_PREAMBLE;
-						}
+	corrected = frame ^ error;
 
-					} else {
-						if (data->isOne) {
-							this->nibble |= (1 << (3 - this->nibbleLen++));
-						} else {
-							this->nibble &= ~(1 << (3 - this->nibbleLen++));
-						}
-					}
-				}
-				break;
-		}
-	}
+	return true;
 }
 
 
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rfid/Em4100Writer.hpp"
+#include "rfid/Em4100Eprom.hpp"
+
+
+void rfid::Em4100Writer::write(rfid::device::Interface &iface, T5557Encoder::DataRate dataRate, T5557Encoder::Modulation modulation, uint8_t customerId, uint32_t token) {
+	std::vector<rfid::device::Interface::Sample> samples;
+
+	uint32_t em4100Eprom[2];
+
+	{
+		rfid::T5557Encoder::Parameters params;
+
+		params.dataRate   = dataRate;
+		params.modulation = modulation;
+
+		// Block 0 is a configuration block, 1 and 2 are data blocks.
+		params.maxBlock = sizeof(em4100Eprom) / sizeof(*em4100Eprom);
+
+		samples.clear();
+		rfid::T5557Encoder::encodeParameters(params, false, 0, samples);
+		iface.putSamples(samples);
+	}
+
+	{
+		rfid::Em4100Eprom::generate(em4100Eprom, customerId, token);
+
+		samples.clear();
+		rfid::T5557Encoder::encodeBlock(0, 1, false, false, 0, em4100Eprom[0], samples);
+		iface.putSamples(samples);
+
+		samples.clear();
+		rfid::T5557Encoder::encodeBlock(0, 2, false, false, 0, em4100Eprom[1], samples);
+		iface.putSamples(samples);
+	}
+}
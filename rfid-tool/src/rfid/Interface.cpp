@@ -17,4 +17,7 @@
 
 #include "rfid/Interface.hpp"
 
-const int rfid::device::Interface::CARRIER_US = 8;
+constexpr int rfid::device::Interface::CARRIER_US;
+
+const uint16_t rfid::device::Interface::Sample::LEVEL_MASK;
+const uint16_t rfid::device::Interface::Sample::LENGTH_MASK;
@@ -21,11 +21,16 @@
 #include "impl/InterfaceUsbImpl.hpp"
 
 rfid::device::Interface *rfid::device::InterfaceFactory::newInstance(Type type) {
+	return newInstance(type, "");
+}
+
+
+rfid::device::Interface *rfid::device::InterfaceFactory::newInstance(Type type, const std::string &key) {
 	rfid::device::Interface *ret = nullptr;
 
 	switch (type) {
 		case InterfaceFactory::TYPE_USB:
-			ret = new rfid::device::InterfaceUsbImpl();
+			ret = new rfid::device::InterfaceUsbImpl(key);
 			break;
 
 		default:
@@ -38,3 +43,16 @@ rfid::device::Interface *rfid::device::InterfaceFactory::newInstance(Type type)
 
 	return ret;
 }
+
+
+std::vector<std::string> rfid::device::InterfaceFactory::enumerate(Type type) {
+	switch (type) {
+		case InterfaceFactory::TYPE_USB:
+			return rfid::device::InterfaceUsbImpl::enumerate();
+
+		default:
+			break;
+	}
+
+	throw common::Exception("Not supported type!", 1);
+}
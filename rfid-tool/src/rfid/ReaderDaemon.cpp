@@ -0,0 +1,403 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include "rfid/ReaderDaemon.hpp"
+#include "rfid/DaemonProtocol.h"
+#include "rfid/Em4100Writer.hpp"
+
+#include "common/Log.hpp"
+
+#define POLL_TIMEOUT_MS 100
+#define LISTEN_BACKLOG    8
+
+// Requests a client may have buffered before it is dropped
+#define CLIENT_REQUESTS_MAX 4
+#define CLIENT_BUFFER_MAX   ((DAEMON_HEADER_SIZE + DAEMON_PAYLOAD_MAX) * CLIENT_REQUESTS_MAX)
+
+using namespace common;
+
+
+/*
+ * Appends at most one request worth of data, the rest is read after the next poll(), so a client
+ * writing continuously does not starve the others. Returns false when the client disconnected.
+ */
+static bool _readChunk(int fd, std::vector<uint8_t> &buffer) {
+	uint8_t chunk[DAEMON_HEADER_SIZE + DAEMON_PAYLOAD_MAX];
+	ssize_t rc = recv(fd, chunk, sizeof(chunk), 0);
+
+	if (rc < 0) {
+		// Interrupted read is finished after the next poll()
+		return (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR);
+
+	} else if (rc == 0) {
+		return false;
+	}
+
+	buffer.insert(buffer.end(), chunk, chunk + rc);
+
+	return true;
+}
+
+
+static bool _writeAll(int fd, const uint8_t *buffer, size_t bufferSize) {
+	while (bufferSize > 0) {
+		ssize_t rc = send(fd, buffer, bufferSize, MSG_NOSIGNAL);
+
+		if (rc < 0) {
+			if (errno == EINTR) {
+				continue;
+
+			} else if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+				struct pollfd pfd = { fd, POLLOUT, 0 };
+
+				// Client not reading its responses is dropped
+				if (poll(&pfd, 1, POLL_TIMEOUT_MS) > 0) {
+					continue;
+				}
+			}
+
+			return false;
+		}
+
+		buffer     += rc;
+		bufferSize -= rc;
+	}
+
+	return true;
+}
+
+
+rfid::ReaderDaemon::ReaderDaemon(const std::string &socketPath, rfid::device::InterfaceFactory::Type type, const std::string &deviceKey, rfid::device::Interface::RxMode rxMode) {
+	this->socketPath   = socketPath;
+	this->type         = type;
+	this->deviceKey    = deviceKey;
+	this->rxMode       = rxMode;
+	this->tokenFound   = false;
+
+	{
+		struct sockaddr_un addr;
+
+		if (socketPath.size() >= sizeof(addr.sun_path)) {
+			throw common::Exception("Socket path is too long!");
+		}
+
+		memset(&addr, 0, sizeof(addr));
+
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, socketPath.c_str());
+
+		this->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (this->listenFd < 0) {
+			throw common::Exception("Unable to create socket!", errno);
+		}
+
+		unlink(socketPath.c_str());
+
+		if (
+			(bind(this->listenFd, (struct sockaddr *) &addr, sizeof(addr)) < 0) ||
+			(listen(this->listenFd, LISTEN_BACKLOG) < 0)
+		) {
+			int error = errno;
+
+			close(this->listenFd);
+
+			throw common::Exception("Unable to listen on " + socketPath + ": " + strerror(error), error);
+		}
+	}
+
+	this->decoderBank.addListener(&this->voter);
+	this->voter.addListener(this);
+}
+
+
+rfid::ReaderDaemon::~ReaderDaemon() {
+	this->voter.removeListener(this);
+	this->decoderBank.removeListener(&this->voter);
+
+	for (const Client &client : this->clients) {
+		close(client.fd);
+	}
+
+	close(this->listenFd);
+
+	unlink(this->socketPath.c_str());
+}
+
+
+void rfid::ReaderDaemon::run(const std::function<bool()> &isDone) {
+	Log::log("Listening on %s", this->socketPath.c_str());
+
+	while (! isDone()) {
+		std::vector<struct pollfd> fds;
+
+		fds.push_back({ this->listenFd, POLLIN, 0 });
+
+		for (const Client &client : this->clients) {
+			fds.push_back({ client.fd, POLLIN, 0 });
+		}
+
+		if (poll(fds.data(), fds.size(), POLL_TIMEOUT_MS) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+
+			throw common::Exception("poll() failed!", errno);
+		}
+
+		if (fds[0].revents & POLLIN) {
+			int fd = accept(this->listenFd, nullptr, nullptr);
+
+			if (fd >= 0) {
+				if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+					Log::error("Unable to make client socket non-blocking (%s)", strerror(errno));
+
+					close(fd);
+
+				} else {
+					Log::debug("New client %d", fd);
+
+					this->clients.push_back({ fd, std::vector<uint8_t>() });
+				}
+			}
+		}
+
+		// Clients accepted above are polled in the next round
+		for (size_t i = fds.size() - 1; i > 0; i--) {
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				if (! this->handleClient(this->clients[i - 1])) {
+					Log::debug("Client %d disconnected", fds[i].fd);
+
+					close(fds[i].fd);
+
+					this->clients.erase(this->clients.begin() + (i - 1));
+				}
+			}
+		}
+	}
+}
+
+
+bool rfid::ReaderDaemon::handleClient(Client &client) {
+	std::vector<uint8_t> &buffer = client.rxBuffer;
+
+	bool connected = _readChunk(client.fd, buffer);
+
+	if (buffer.size() > CLIENT_BUFFER_MAX) {
+		Log::error("Client %d exceeded request backlog", client.fd);
+
+		return false;
+	}
+
+	// Every complete request is served, even when the client already closed its side
+	while (buffer.size() >= DAEMON_HEADER_SIZE) {
+		uint16_t payloadSize = (buffer[1] << 8) | buffer[2];
+
+		if (payloadSize > DAEMON_PAYLOAD_MAX) {
+			Log::error("Request payload too long (%u)", payloadSize);
+
+			return false;
+		}
+
+		if (buffer.size() < (size_t) DAEMON_HEADER_SIZE + payloadSize) {
+			break;
+		}
+
+		{
+			std::vector<uint8_t> response(DAEMON_HEADER_SIZE);
+
+			response[0] = this->handleRequest(buffer[0], buffer.data() + DAEMON_HEADER_SIZE, payloadSize, response);
+			response[1] = (response.size() - DAEMON_HEADER_SIZE) >> 8;
+			response[2] = (response.size() - DAEMON_HEADER_SIZE) & 0xff;
+
+			if (! _writeAll(client.fd, response.data(), response.size())) {
+				return false;
+			}
+		}
+
+		buffer.erase(buffer.begin(), buffer.begin() + DAEMON_HEADER_SIZE + payloadSize);
+	}
+
+	return connected;
+}
+
+
+uint8_t rfid::ReaderDaemon::handleRequest(uint8_t command, const uint8_t *payload, uint16_t payloadSize, std::vector<uint8_t> &response) {
+	switch (command) {
+		case DAEMON_CMD_STATUS:
+			{
+				std::shared_ptr<rfid::device::Interface::FirmwareVersion> version;
+
+				try {
+					version = this->getInterface().getVersion();
+
+				} catch (const common::Exception &ex) {
+					Log::debug("Interface not available: %s", ex.getMessage().c_str());
+				}
+
+				response.push_back(version ? 1 : 0);
+				response.push_back(version ? version->getMajor() : 0);
+				response.push_back(version ? version->getMinor() : 0);
+			}
+			return DAEMON_RC_OK;
+
+		case DAEMON_CMD_READ:
+			{
+				if (payloadSize != 1) {
+					return DAEMON_RC_INVALID_VAL;
+				}
+
+				try {
+					if (! this->readToken(payload[0] ? payload[0] : 1)) {
+						return DAEMON_RC_NO_TOKEN;
+					}
+
+				} catch (const common::Exception &ex) {
+					Log::error("Read failed: %s", ex.getMessage().c_str());
+
+					this->iface.reset();
+
+					return DAEMON_RC_DEVICE_ERROR;
+				}
+
+				response.push_back(this->token.carrierDivider);
+				response.push_back(this->token.modulation == rfid::DecoderBank::MODULATION_BIPHASE ? DAEMON_MODULATION_BIPHASE : DAEMON_MODULATION_MANCHESTER);
+				response.push_back(this->token.versionOrCustomerId);
+				response.push_back(this->token.data >> 24);
+				response.push_back(this->token.data >> 16);
+				response.push_back(this->token.data >>  8);
+				response.push_back(this->token.data);
+			}
+			return DAEMON_RC_OK;
+
+		case DAEMON_CMD_WRITE:
+			{
+				rfid::T5557Encoder::DataRate   dataRate;
+				rfid::T5557Encoder::Modulation modulation;
+
+				if (payloadSize != 7) {
+					return DAEMON_RC_INVALID_VAL;
+				}
+
+				if (! rfid::T5557Encoder::getDataRate(payload[0], dataRate)) {
+					return DAEMON_RC_INVALID_VAL;
+				}
+
+				switch (payload[1]) {
+					case DAEMON_MODULATION_MANCHESTER: modulation = rfid::T5557Encoder::MODULATION_MANCHESTER; break;
+					case DAEMON_MODULATION_BIPHASE:    modulation = rfid::T5557Encoder::MODULATION_BIPHASE;    break;
+
+					default:
+						return DAEMON_RC_INVALID_VAL;
+				}
+
+				try {
+					rfid::Em4100Writer::write(
+						this->getInterface(), dataRate, modulation, payload[2],
+						((uint32_t) payload[3] << 24) | ((uint32_t) payload[4] << 16) | ((uint32_t) payload[5] << 8) | payload[6]
+					);
+
+				} catch (const common::Exception &ex) {
+					Log::error("Write failed: %s", ex.getMessage().c_str());
+
+					this->iface.reset();
+
+					return DAEMON_RC_DEVICE_ERROR;
+				}
+			}
+			return DAEMON_RC_OK;
+
+		default:
+			break;
+	}
+
+	return DAEMON_RC_INVALID_CMD;
+}
+
+
+rfid::device::Interface &rfid::ReaderDaemon::getInterface() {
+	if (! this->iface) {
+		this->iface.reset(rfid::device::InterfaceFactory::newInstance(this->type, this->deviceKey));
+
+		if (! this->iface->isConnected()) {
+			this->iface.reset();
+
+			throw rfid::device::Interface::NotConnectedException();
+		}
+
+		this->iface->setRxMode(this->rxMode);
+	}
+
+	return *this->iface;
+}
+
+
+bool rfid::ReaderDaemon::readToken(uint8_t captures) {
+	rfid::device::Interface &iface = this->getInterface();
+
+	this->tokenFound = false;
+
+	// Votes are collected across captures, reading stops once enough frames agree
+	this->voter.reset();
+
+	for (uint8_t i = 0; (i < captures) && ! this->tokenFound; i++) {
+		size_t decoded = 0;
+
+		this->decoderBank.restart();
+
+		// Samples are decoded while the capture runs, it is stopped once the token is confirmed
+		try {
+			iface.getSamples(this->samples, [this, &decoded](const std::vector<rfid::device::Interface::Sample> &samples) {
+				this->decoderBank.checkPulses(samples.data() + decoded, samples.size() - decoded);
+
+				decoded = samples.size();
+
+				return this->tokenFound;
+			});
+
+		} catch (const rfid::device::Interface::TimeoutException &ex) {
+			continue;
+		}
+	}
+
+	// Token of another bitrate may not fit the shortened window
+	if (! this->tokenFound) {
+		iface.setCaptureWindow(0, 0);
+	}
+
+	return this->tokenFound;
+}
+
+
+void rfid::ReaderDaemon::onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+	if ((eventId == rfid::TokenVoter::EVENT_NEW_TOKEN) && ! this->tokenFound) {
+		this->token      = *reinterpret_cast<rfid::TokenVoter::EventNewTokenData *>(eventData)->token;
+		this->tokenFound = true;
+
+		// Next reads capture only the window needed at the detected bitrate
+		this->iface->setCaptureWindow(this->token.carrierDivider, rfid::device::Interface::CAPTURE_WINDOW_FRAMES);
+	}
+}
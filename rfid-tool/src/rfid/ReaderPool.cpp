@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <functional>
+
+#include "rfid/ReaderPool.hpp"
+#include "rfid/DecoderBank.hpp"
+#include "rfid/TokenVoter.hpp"
+
+#include "common/Log.hpp"
+
+
+class TokenForwarder : public common::Listener {
+	public:
+		TokenForwarder(std::function<void(rfid::TokenVoter::EventNewTokenData &)> callback) : callback(callback) {
+		}
+
+		void onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+			if (eventId == rfid::TokenVoter::EVENT_NEW_TOKEN) {
+				this->callback(*reinterpret_cast<rfid::TokenVoter::EventNewTokenData *>(eventData));
+			}
+		}
+
+	private:
+		std::function<void(rfid::TokenVoter::EventNewTokenData &)> callback;
+};
+
+
+class FrameCounter : public common::Listener {
+	public:
+		FrameCounter() : frames(0) {
+		}
+
+		void onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+			if (eventId == rfid::DecoderBank::EVENT_NEW_TOKEN) {
+				this->frames++;
+			}
+		}
+
+	public:
+		unsigned frames;
+};
+
+
+rfid::ReaderPool::ReaderPool() : running(false) {
+}
+
+
+rfid::ReaderPool::~ReaderPool() {
+	this->stop();
+}
+
+
+void rfid::ReaderPool::addReader(rfid::device::Interface *iface) {
+	std::unique_ptr<Reader> reader(new Reader());
+
+	reader->iface.reset(iface);
+
+	this->readers.push_back(std::move(reader));
+}
+
+
+void rfid::ReaderPool::start() {
+	if (this->running) {
+		return;
+	}
+
+	this->running = true;
+
+	for (auto &reader : this->readers) {
+		Reader *r = reader.get();
+
+		r->thread = std::thread([this, r]() {
+			this->run(*r);
+		});
+	}
+}
+
+
+void rfid::ReaderPool::stop() {
+	this->running = false;
+
+	for (auto &reader : this->readers) {
+		if (reader->thread.joinable()) {
+			reader->thread.join();
+		}
+	}
+}
+
+
+void rfid::ReaderPool::run(Reader &reader) {
+	const std::string &key = reader.iface->getKey();
+
+	TokenForwarder forwarder([this, &key](rfid::TokenVoter::EventNewTokenData &vote) {
+		std::lock_guard<std::mutex> lock(this->notifyMutex);
+
+		const rfid::DecoderBank::EventNewTokenData &token = *vote.token;
+
+		std::string modulation = token.codingDecoder->getName();
+
+		EventNewTokenData data;
+
+		data.readerKey           = &key;
+		data.carrierDivider      = token.carrierDivider;
+		data.modulation          = &modulation;
+		data.data                = token.data;
+		data.versionOrCustomerId = token.versionOrCustomerId;
+		data.confidence          = vote.confidence;
+
+		this->notify(EVENT_NEW_TOKEN, &data);
+	});
+
+	try {
+		// Decoders and sample storage live as long as the thread, reads do not allocate
+		std::vector<rfid::device::Interface::Sample> samples;
+
+		rfid::DecoderBank decoderBank;
+		rfid::TokenVoter  voter;
+		FrameCounter      counter;
+
+		decoderBank.addListener(&voter);
+		decoderBank.addListener(&counter);
+		voter.addListener(&forwarder);
+
+		while (this->running) {
+			try {
+				reader.iface->getSamples(samples);
+
+			} catch (const rfid::device::Interface::TimeoutException &ex) {
+				// No signal in the field, votes of a removed tag must not complete the next one
+				voter.reset();
+				continue;
+			}
+
+			counter.frames = 0;
+
+			decoderBank.restart();
+			decoderBank.checkPulses(samples);
+
+			if (counter.frames == 0) {
+				voter.reset();
+			}
+		}
+
+	} catch (const common::Exception &ex) {
+		std::lock_guard<std::mutex> lock(this->notifyMutex);
+
+		EventReaderErrorData data;
+
+		common::Log::error("Reader %s failed: %s", key.c_str(), ex.getMessage().c_str());
+
+		data.readerKey = &key;
+		data.message   = &ex.getMessage();
+
+		this->notify(EVENT_READER_ERROR, &data);
+	}
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "rfid/SoftDecoder.hpp"
+
+
+const uint8_t  rfid::SoftDecoder::CELLS_MAX;
+const uint32_t rfid::SoftDecoder::VIOLATION_COST;
+const uint32_t rfid::SoftDecoder::SUSPECT_ERROR;
+const uint32_t rfid::SoftDecoder::ERROR_MAX;
+
+
+rfid::SoftDecoder::SoftDecoder(uint8_t carrierDivider, Coding coding) {
+	this->carrierDivider = carrierDivider;
+	this->coding         = coding;
+	this->reportCell     = 0;
+}
+
+
+rfid::SoftDecoder::~SoftDecoder() {
+}
+
+
+void rfid::SoftDecoder::setCarrierDivider(uint8_t carrierDivider) {
+	this->carrierDivider = carrierDivider;
+}
+
+
+void rfid::SoftDecoder::decode(const rfid::device::Interface::Sample *samples, size_t samplesCount) {
+	NotifierSink sink(*this);
+
+	this->decode(samples, samplesCount, sink);
+}
+
+
+uint32_t rfid::SoftDecoder::getLengthError(uint16_t pulseLength, uint8_t cellsCount) const {
+	int32_t deviation = 2 * (int32_t) pulseLength - cellsCount * (int32_t) this->carrierDivider;
+
+	if (deviation < 0) {
+		deviation = -deviation;
+	}
+
+	return std::min<uint32_t>(deviation * 16 / this->carrierDivider, ERROR_MAX);
+}
+
+
+uint8_t rfid::SoftDecoder::getViolations(uint8_t phase, uint8_t cellsCount) const {
+	// Manchester changes level in the middle of every bit, Biphase on every bit boundary
+	uint8_t forbidden = (this->coding == CODING_MANCHESTER) ? 0 : 1;
+	uint8_t ret       = 0;
+
+	for (uint8_t cell = phase; cell + 1 < phase + cellsCount; cell++) {
+		if ((cell & 1) == forbidden) {
+			ret++;
+		}
+	}
+
+	return ret;
+}
+
+
+void rfid::SoftDecoder::align(const rfid::device::Interface::Sample *samples, size_t samplesCount, size_t reportFrom) {
+	uint32_t metric[2] = { 0, 0 };
+	uint8_t  phase;
+
+	this->choices.resize(samplesCount);
+	this->cells.clear();
+
+	this->reportCell = 0;
+
+	if (this->carrierDivider == 0) {
+		return;
+	}
+
+	// Forward pass, state is the phase of the next cell
+	for (size_t i = 0; i < samplesCount; i++) {
+		uint16_t length    = samples[i].getLengthCarriers();
+		uint32_t next[2]   = { UINT32_MAX, UINT32_MAX };
+		uint8_t  choice[2] = { 0, 0 };
+		uint32_t base;
+
+		for (uint8_t cellsCount = 1; cellsCount <= CELLS_MAX; cellsCount++) {
+			uint32_t error = this->getLengthError(length, cellsCount);
+
+			for (uint8_t from = 0; from < 2; from++) {
+				uint8_t  to   = (from + cellsCount) & 1;
+				uint32_t cost = metric[from] + error * error + this->getViolations(from, cellsCount) * VIOLATION_COST;
+
+				if (cost < next[to]) {
+					next[to]   = cost;
+					choice[to] = cellsCount;
+				}
+			}
+		}
+
+		// Only difference of the metrics matters
+		base = std::min(next[0], next[1]);
+
+		metric[0] = next[0] - base;
+		metric[1] = next[1] - base;
+
+		this->choices[i] = choice[0] | (choice[1] << 4);
+	}
+
+	// Trace back from the cheaper end phase
+	phase = (metric[1] < metric[0]) ? 1 : 0;
+
+	for (size_t i = samplesCount; i-- > 0; ) {
+		uint8_t cellsCount = phase ? (this->choices[i] >> 4) : (this->choices[i] & 0x0f);
+
+		this->choices[i] = cellsCount;
+
+		phase = (phase + 2 - (cellsCount & 1)) & 1;
+	}
+
+	// The first half of the first bit was not captured
+	if (phase) {
+		this->cells.push_back(CELL_SUSPECT);
+	}
+
+	for (size_t i = 0; i < samplesCount; i++) {
+		uint8_t cellsCount = this->choices[i];
+
+		if (i == reportFrom) {
+			this->reportCell = this->cells.size();
+		}
+
+		uint8_t cell       = samples[i].isLow() ? 0 : CELL_HIGH;
+
+		if (this->getViolations(phase, cellsCount) || (this->getLengthError(samples[i].getLengthCarriers(), cellsCount) >= SUSPECT_ERROR)) {
+			cell |= CELL_SUSPECT;
+		}
+
+		this->cells.insert(this->cells.end(), cellsCount, cell);
+
+		phase = (phase + cellsCount) & 1;
+	}
+}
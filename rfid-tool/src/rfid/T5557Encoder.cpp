@@ -48,7 +48,7 @@ class TransferData {
 		}
 
 		void addPulse(bool high, int length) {
-			this->samples.push_back(rfid::device::Interface::Sample(length, high));
+			this->samples.push_back(rfid::device::Interface::Sample::fromCarriers(length, high));
 		}
 
 		void addBit(uint8_t bit) {
@@ -80,10 +80,11 @@ class TransferData {
 		std::vector<rfid::device::Interface::Sample> &samples;
 };
 
-const int TransferData::SL_FIXED_DATA_ONE  = rfid::device::Interface::CARRIER_US * ((48 + 63) / 2);
-const int TransferData::SL_FIXED_DATA_ZERO = rfid::device::Interface::CARRIER_US * ((16 + 31) / 2);
-const int TransferData::SL_FIXED_WRITE_GAP = rfid::device::Interface::CARRIER_US * (( 8 + 30) / 2);
-const int TransferData::SL_FIXED_START_GAP = rfid::device::Interface::CARRIER_US * ((10 + 50) / 2);
+// Carrier periods
+const int TransferData::SL_FIXED_DATA_ONE  = (48 + 63) / 2;
+const int TransferData::SL_FIXED_DATA_ZERO = (16 + 31) / 2;
+const int TransferData::SL_FIXED_WRITE_GAP = ( 8 + 30) / 2;
+const int TransferData::SL_FIXED_START_GAP = (10 + 50) / 2;
 
 
 void rfid::T5557Encoder::encodeBlock(uint8_t page, uint8_t block, bool lock, bool passwordSend, uint32_t password, uint32_t data, std::vector<rfid::device::Interface::Sample> &samples) {
@@ -175,3 +176,22 @@ void rfid::T5557Encoder::encodeParameters(const Parameters &params, bool passwor
 
 	encodeBlock(0, 0, params.lock, passwordSend, password, data, samples);
 }
+
+
+bool rfid::T5557Encoder::getDataRate(uint8_t carrierDivider, DataRate &dataRate) {
+	switch (carrierDivider) {
+		case   8: dataRate = DATA_RATE_8;   break;
+		case  16: dataRate = DATA_RATE_16;  break;
+		case  32: dataRate = DATA_RATE_32;  break;
+		case  40: dataRate = DATA_RATE_40;  break;
+		case  50: dataRate = DATA_RATE_50;  break;
+		case  64: dataRate = DATA_RATE_64;  break;
+		case 100: dataRate = DATA_RATE_100; break;
+		case 128: dataRate = DATA_RATE_128; break;
+
+		default:
+			return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rfid/TokenVoter.hpp"
+
+#include "common/Log.hpp"
+
+
+const uint8_t rfid::TokenVoter::VOTES_DEFAULT;
+
+rfid::TokenVoter::TokenVoter(uint8_t votesRequired) : confident(false) {
+	this->votesRequired = votesRequired ? votesRequired : 1;
+
+	this->reset();
+}
+
+
+rfid::TokenVoter::~TokenVoter() {
+}
+
+
+void rfid::TokenVoter::reset() {
+	this->confident = false;
+
+	this->startRound();
+}
+
+
+void rfid::TokenVoter::startRound() {
+	this->candidatesCount = 0;
+	this->frames          = 0;
+}
+
+
+void rfid::TokenVoter::setVotesRequired(uint8_t votesRequired) {
+	this->votesRequired = votesRequired ? votesRequired : 1;
+}
+
+
+void rfid::TokenVoter::onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+	if (eventId == rfid::DecoderBank::EVENT_NEW_TOKEN) {
+		rfid::DecoderBank::EventNewTokenData *token = reinterpret_cast<rfid::DecoderBank::EventNewTokenData *>(eventData);
+
+		Candidate *candidate = nullptr;
+
+		if (this->frames < UINT8_MAX) {
+			this->frames++;
+		}
+
+		for (uint8_t i = 0; i < this->candidatesCount; i++) {
+			if ((this->candidates[i].token.data == token->data) && (this->candidates[i].token.versionOrCustomerId == token->versionOrCustomerId)) {
+				candidate = &this->candidates[i];
+				break;
+			}
+		}
+
+		if (candidate == nullptr) {
+			// Replace the weakest candidate when all slots are taken
+			if (this->candidatesCount < CANDIDATES_MAX) {
+				candidate = &this->candidates[this->candidatesCount++];
+
+			} else {
+				candidate = &this->candidates[0];
+
+				for (uint8_t i = 1; i < this->candidatesCount; i++) {
+					if (this->candidates[i].votes < candidate->votes) {
+						candidate = &this->candidates[i];
+					}
+				}
+			}
+
+			candidate->votes = 0;
+		}
+
+		candidate->token = *token;
+		candidate->votes++;
+
+		common::Log::debug("Token %#x: %u of %u votes, %u frames", token->data, candidate->votes, this->votesRequired, this->frames);
+
+		if (candidate->votes >= this->votesRequired) {
+			EventNewTokenData data;
+
+			data.token      = &candidate->token;
+			data.votes      = candidate->votes;
+			data.confidence = (uint16_t) candidate->votes * 100 / this->frames;
+
+			this->confident = true;
+
+			this->notify(EVENT_NEW_TOKEN, &data);
+
+			this->startRound();
+		}
+	}
+}
@@ -36,35 +36,9 @@ void rfid::BiphaseDecoder::reset() {
 
 void rfid::BiphaseDecoder::onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
 	if (eventId == rfid::CarrierDecoder::EVENT_NEW_PULSE) {
-		rfid::CarrierDecoder::EventPulseData *data = reinterpret_cast<rfid::CarrierDecoder::EventPulseData*>(eventData);
+		NotifierSink sink(*this);
 
-		if (data->isLong) {
-			this->_lastShort = false;
-
-			{
-				EventBitData eventData;
-
-				eventData.isOne = true;
-
-				this->notify(EVENT_NEW_BIT, &eventData);
-			}
-
-		} else {
-			if (this->_lastShort) {
-				this->_lastShort = false;
-
-				{
-					EventBitData eventData;
-
-					eventData.isOne = false;
-
-					this->notify(EVENT_NEW_BIT, &eventData);
-				}
-
-			} else {
-				this->_lastShort = true;
-			}
-		}
+		this->decodePulse(*reinterpret_cast<rfid::CarrierDecoder::EventPulseData*>(eventData), sink);
 
 	} else if (eventId == rfid::CarrierDecoder::EVENT_SYNC_CHANGED) {
 		this->reset();
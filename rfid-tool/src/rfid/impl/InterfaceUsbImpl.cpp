@@ -17,9 +17,16 @@
 
 #include <cstring>
 #include <set>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <algorithm>
 
 #include "common/protocol.h"
 #include "common/Log.hpp"
+#include "rfid/BitmapDecoder.hpp"
 #include "InterfaceUsbImpl.hpp"
 
 
@@ -29,6 +36,30 @@
 
 #define DEFAULT_TIMEOUT 500
 
+#define EVENT_LOOP_TIMEOUT_US 100000
+
+// Firmware evaluates transfer state changes only after 5ms of USB inactivity.
+#define TRANSFER_LATENCY_US   5000
+// Status polls closer than the firmware idle window would starve the state machine.
+#define TRANSFER_POLL_MIN_US  6000
+// Firmware 0.4 handles state changes right after the request, only USB frame latency is left.
+#define TRANSFER_LATENCY_FAST_US  1000
+#define TRANSFER_POLL_FAST_MIN_US 1000
+#define TRANSFER_POLL_MAX_US 50000
+#define TRANSFER_GUARD_US   100000
+
+// Carrier periods per sample of bitmap captures and streams
+#define RX_PRESCALER 8
+
+// Running capture is read in about this many parts
+#define RANGE_READ_PARTS 8
+
+// Bits of one EM4100 frame
+#define CAPTURE_FRAME_BITS 64
+
+// Maximal number of requests queued at once
+#define TRANSFER_POOL_SIZE 4
+
 using namespace common;
 
 
@@ -38,69 +69,348 @@ class UsbFirmwareVersion : public rfid::device::Interface::FirmwareVersion {
 		}
 
 		bool isSupported() {
-			return this->getMajor() == 0 && this->getMinor() == 1;
+			return this->getMajor() == 0 && this->getMinor() >= 1 && this->getMinor() <= 8;
 		}
-};
 
+		bool hasStreaming() {
+			return this->getMinor() >= 2;
+		}
 
-#define VERSION(__this)((UsbFirmwareVersion *)__this->version.get())
+		bool hasRle() {
+			return this->getMinor() >= 3;
+		}
 
+		bool hasFastDispatch() {
+			return this->getMinor() >= 4;
+		}
 
-static int usbGetStringAscii(usb_dev_handle *dev, int index, char *buf, int buflen) {
-	int ret = 0;
+		bool hasCompletionEndpoint() {
+			return this->getMinor() >= 5;
+		}
 
-	do {
-		char buffer[256] = { 0 };
-		int rval = 0;
-		int i;
+		bool hasRangedRead() {
+			return this->getMinor() >= 6;
+		}
 
-		ret = usb_get_string_simple(dev, index, buf, buflen);
-		if (ret >= 0) {
-			Log::debug("usbGetStringAscii(): Read by usb_get_string_simple");
-			break;
+		bool hasCaptureLength() {
+			return this->getMinor() >= 7;
 		}
 
-		ret = usb_control_msg(dev, USB_ENDPOINT_IN, USB_REQ_GET_DESCRIPTOR, (USB_DT_STRING << 8) + index, 0x0409, buffer, sizeof(buffer), 5000);
-		if (ret < 0) {
-			Log::debug("usbGetStringAscii(): usb_control_msg() returned error! %d", ret);
-			break;
+		bool hasEdgeTiming() {
+			return this->getMinor() >= 8;
 		}
+};
 
-		if (buffer[1] != USB_DT_STRING) {
-			Log::debug("usbGetStringAscii(): no string data! %02x", buffer[1]);
 
-			*buf = 0;
+/*
+ * Converts sampler RLE entries into samples. Entries of the same level are merged, the last run is
+ * kept pending because the sampler stops in the middle of it. State is kept between calls, so
+ * consecutive parts of the buffer are decoded as one signal.
+ */
+class RleDecoder {
+	public:
+		RleDecoder(uint16_t prescaler) {
+			this->prescaler          = prescaler;
+			this->currentState       = -1;
+			this->currentStateLength = 0;
+		}
 
-			ret = 0;
-			break;
+		void decode(const uint8_t *buffer, uint16_t bufferSize, std::vector<rfid::device::Interface::Sample> &samples) {
+			for (int i = 0; i < bufferSize; i++) {
+				int state = (buffer[i] & PROTO_RLE_LEVEL_MASK) != 0;
+
+				if (state != this->currentState) {
+					if (this->currentState != -1) {
+						samples.push_back(
+							rfid::device::Interface::Sample::fromCarriers(this->currentStateLength * this->prescaler, ! this->currentState)
+						);
+					}
+
+					this->currentState       = state;
+					this->currentStateLength = 0;
+				}
+
+				this->currentStateLength += buffer[i] & PROTO_RLE_LENGTH_MASK;
+			}
 		}
 
-		if ((uint8_t) buffer[0] < ret) {
-			ret = (uint8_t) buffer[0];
+	private:
+		uint16_t prescaler;
+
+		int currentState;
+		int currentStateLength;
+};
+
+
+#define VERSION(__this)((UsbFirmwareVersion *)__this->version.get())
+
+
+/*
+ * libusb context and event thread shared by all USB interfaces. Completions of asynchronous
+ * transfers of every opened reader are dispatched from this single thread.
+ */
+class UsbEventLoop {
+	public:
+		static libusb_context *acquire() {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (users == 0) {
+				int rc = libusb_init(&context);
+				if (rc != LIBUSB_SUCCESS) {
+					throw common::Exception(std::string("Unable to initialize libusb: ") + libusb_error_name(rc), rc);
+				}
+
+				running = true;
+				thread  = std::thread(run);
+			}
+
+			users++;
+
+			return context;
 		}
 
-		ret /= 2;
+		static void release() {
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (--users == 0) {
+				running = false;
+				thread.join();
 
-		for (i = 1; i < rval; i++){
-			if (i > buflen) {
-				break;
+				libusb_exit(context);
+				context = nullptr;
 			}
+		}
 
-			buf[i - 1] = buffer[2 * i];
+	private:
+		static void run() {
+			while (running) {
+				struct timeval tv = { 0, EVENT_LOOP_TIMEOUT_US };
 
-			if (buffer[2 * i + 1] != 0) {
-				buf[i - 1] = '?';
+				libusb_handle_events_timeout_completed(context, &tv, nullptr);
 			}
 		}
 
-		buf[i - 1] = 0;
-	} while (0);
+	private:
+		static std::mutex        mutex;
+		static std::thread       thread;
+		static std::atomic<bool> running;
+		static libusb_context   *context;
+		static int               users;
+};
+
+std::mutex        UsbEventLoop::mutex;
+std::thread       UsbEventLoop::thread;
+std::atomic<bool> UsbEventLoop::running(false);
+libusb_context   *UsbEventLoop::context = nullptr;
+int               UsbEventLoop::users   = 0;
+
+
+// Stable reader identifier built from bus number and port path, e.g. "1-2.3"
+static std::string _deviceKey(libusb_device *device) {
+	uint8_t ports[8];
+
+	int portsCount = libusb_get_port_numbers(device, ports, sizeof(ports));
+
+	std::string ret = std::to_string(libusb_get_bus_number(device));
+
+	for (int i = 0; i < portsCount; i++) {
+		ret += (i == 0) ? "-" : ".";
+		ret += std::to_string(ports[i]);
+	}
 
 	return ret;
 }
 
 
-rfid::device::InterfaceUsbImpl::_init rfid::device::InterfaceUsbImpl::_initializer;
+/*
+ * Calls callback with an opened handle for every attached reader. Handle is closed after the
+ * callback returns false, true means that callback took the handle and the search is finished.
+ */
+static void _findReaders(libusb_context *context, const std::function<bool(libusb_device_handle *, const std::string &)> &callback) {
+	libusb_device **devices;
+
+	ssize_t devicesCount = libusb_get_device_list(context, &devices);
+
+	for (ssize_t i = 0; i < devicesCount; i++) {
+		struct libusb_device_descriptor descriptor;
+
+		libusb_device_handle *tmpHandle = nullptr;
+
+		if (libusb_get_device_descriptor(devices[i], &descriptor) != LIBUSB_SUCCESS) {
+			continue;
+		}
+
+		if (
+			(descriptor.idVendor  != DEV_USB_VID) ||
+			(descriptor.idProduct != DEV_USB_PID) ||
+			(descriptor.iProduct  == 0)
+		) {
+			continue;
+		}
+
+		if (libusb_open(devices[i], &tmpHandle) != LIBUSB_SUCCESS) {
+			continue;
+		}
+
+		{
+			unsigned char iProductBuffer[255];
+
+			if (libusb_get_string_descriptor_ascii(tmpHandle, descriptor.iProduct, iProductBuffer, sizeof(iProductBuffer)) >= 0) {
+				if (strcmp((const char *) iProductBuffer, DEV_USB_PROD) == 0) {
+					if (callback(tmpHandle, _deviceKey(devices[i]))) {
+						break;
+					}
+				}
+			}
+		}
+
+		libusb_close(tmpHandle);
+	}
+
+	if (devicesCount >= 0) {
+		libusb_free_device_list(devices, 1);
+	}
+}
+
+
+class rfid::device::InterfaceUsbImpl::Transfer {
+	public:
+		Transfer(libusb_device_handle *handle) {
+			this->handle    = handle;
+			this->busy      = false;
+			this->completed = true;
+
+			this->transfer = libusb_alloc_transfer(0);
+			if (this->transfer == nullptr) {
+				throw common::Exception("Unable to allocate USB transfer!");
+			}
+		}
+
+		virtual ~Transfer() {
+			this->release();
+
+			libusb_free_transfer(this->transfer);
+		}
+
+		bool isBusy() const {
+			return this->busy;
+		}
+
+		void submit(uint8_t requestType, uint8_t command, uint16_t value, uint16_t index, const uint8_t *data, uint16_t dataSize) {
+			// Grows only until the largest request is seen
+			if (this->buffer.size() < (size_t) LIBUSB_CONTROL_SETUP_SIZE + dataSize) {
+				this->buffer.resize(LIBUSB_CONTROL_SETUP_SIZE + dataSize);
+			}
+
+			libusb_fill_control_setup(this->buffer.data(), requestType, command, value, index, dataSize);
+
+			if ((data != nullptr) && (dataSize > 0)) {
+				memcpy(this->buffer.data() + LIBUSB_CONTROL_SETUP_SIZE, data, dataSize);
+			}
+
+			libusb_fill_control_transfer(this->transfer, this->handle, this->buffer.data(), onComplete, this, DEFAULT_TIMEOUT);
+
+			this->busy      = true;
+			this->completed = false;
+
+			{
+				int rc = libusb_submit_transfer(this->transfer);
+				if (rc != LIBUSB_SUCCESS) {
+					Log::error("Unable to submit transfer (%s)", libusb_error_name(rc));
+
+					this->completed = true;
+
+					throw rfid::device::Interface::InvalidResponseException(rc);
+				}
+			}
+		}
+
+		// Cancels the transfer if it is still pending and makes it available for next request
+		void release() {
+			std::unique_lock<std::mutex> lock(this->mutex);
+
+			if (! this->completed) {
+				libusb_cancel_transfer(this->transfer);
+
+				this->cond.wait(lock, [this]() { return this->completed; });
+			}
+
+			this->busy = false;
+		}
+
+		// Returns number of transferred data bytes or libusb error code
+		int wait() {
+			std::unique_lock<std::mutex> lock(this->mutex);
+
+			this->cond.wait(lock, [this]() { return this->completed; });
+
+			switch (this->transfer->status) {
+				case LIBUSB_TRANSFER_COMPLETED: return this->transfer->actual_length;
+				case LIBUSB_TRANSFER_TIMED_OUT: return LIBUSB_ERROR_TIMEOUT;
+				case LIBUSB_TRANSFER_NO_DEVICE: return LIBUSB_ERROR_NO_DEVICE;
+
+				default:
+					return LIBUSB_ERROR_IO;
+			}
+		}
+
+		const uint8_t *getData() const {
+			return this->buffer.data() + LIBUSB_CONTROL_SETUP_SIZE;
+		}
+
+	private:
+		static void LIBUSB_CALL onComplete(struct libusb_transfer *transfer) {
+			Transfer *self = reinterpret_cast<Transfer *>(transfer->user_data);
+
+			std::lock_guard<std::mutex> lock(self->mutex);
+
+			self->completed = true;
+			self->cond.notify_all();
+		}
+
+	private:
+		libusb_device_handle   *handle;
+		struct libusb_transfer *transfer;
+		std::vector<uint8_t>    buffer;
+
+		// Accessed only by the thread owning the interface
+		bool                    busy;
+
+		std::mutex              mutex;
+		std::condition_variable cond;
+		bool                    completed;
+};
+
+
+class rfid::device::InterfaceUsbImpl::TransferHandle {
+	public:
+		TransferHandle(Transfer *transfer) {
+			this->transfer = transfer;
+		}
+
+		TransferHandle(TransferHandle &&other) {
+			this->transfer = other.transfer;
+
+			other.transfer = nullptr;
+		}
+
+		virtual ~TransferHandle() {
+			if (this->transfer != nullptr) {
+				this->transfer->release();
+			}
+		}
+
+		Transfer &operator*() const {
+			return *this->transfer;
+		}
+
+	private:
+		TransferHandle(const TransferHandle &other) = delete;
+		TransferHandle &operator=(const TransferHandle &other) = delete;
+
+	private:
+		Transfer *transfer;
+};
 
 
 void rfid::device::InterfaceUsbImpl::checkConnection() {
@@ -118,7 +428,7 @@ void rfid::device::InterfaceUsbImpl::checkConnection() {
 
 void rfid::device::InterfaceUsbImpl::checkResponse(const uint8_t *buffer, int bufferSize, int returned, bool checkRc) {
 	if (bufferSize != returned) {
-		Log::error("Returned %d, but expected was %d (%s)", returned, bufferSize, usb_strerror());
+		Log::error("Returned %d, but expected was %d (%s)", returned, bufferSize, returned < 0 ? libusb_error_name(returned) : "short transfer");
 
 		throw rfid::device::Interface::InvalidResponseException(returned);
 	}
@@ -133,36 +443,60 @@ void rfid::device::InterfaceUsbImpl::checkResponse(const uint8_t *buffer, int bu
 }
 
 
-void rfid::device::InterfaceUsbImpl::doTransferRx(uint8_t *buffer, uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command, bool checkRc) {
-	std::shared_ptr<uint8_t> transferBuffer;
-	uint16_t                 transferSize = bufferSize;
+rfid::device::InterfaceUsbImpl::TransferHandle rfid::device::InterfaceUsbImpl::acquireTransfer() {
+	for (auto &transfer : this->transfers) {
+		if (! transfer->isBusy()) {
+			return TransferHandle(transfer.get());
+		}
+	}
+
+	throw common::Exception("No free USB transfer!");
+}
+
 
+rfid::device::InterfaceUsbImpl::TransferHandle rfid::device::InterfaceUsbImpl::submitTransferRx(uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command, bool checkRc) {
 	this->checkConnection();
 
-	if (checkRc) {
-		transferSize++;
-	}
+	TransferHandle ret = this->acquireTransfer();
 
-	if (transferSize) {
-		transferBuffer.reset(new uint8_t[transferSize]);
-	}
+	(*ret).submit(
+		LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_IN,
+		command,
+		value,
+		index,
+		nullptr,
+		checkRc ? bufferSize + 1 : bufferSize
+	);
+
+	return ret;
+}
+
+
+rfid::device::InterfaceUsbImpl::TransferHandle rfid::device::InterfaceUsbImpl::submitTransferTx(const uint8_t *buffer, uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command) {
+	this->checkConnection();
+
+	TransferHandle ret = this->acquireTransfer();
 
-	this->checkResponse(transferBuffer.get(), transferSize,
-		usb_control_msg(
-			this->handle,
-			USB_TYPE_VENDOR | USB_RECIP_DEVICE | USB_ENDPOINT_IN,
-			command,
-			value,
-			index,
-			(char *) transferBuffer.get(),
-			transferSize,
-			DEFAULT_TIMEOUT
-		),
-		checkRc
+	(*ret).submit(
+		LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_OUT,
+		command,
+		value,
+		index,
+		buffer,
+		bufferSize
 	);
 
+	return ret;
+}
+
+
+void rfid::device::InterfaceUsbImpl::finishTransferRx(Transfer &transfer, uint8_t *buffer, uint16_t bufferSize, bool checkRc) {
+	uint16_t transferSize = checkRc ? bufferSize + 1 : bufferSize;
+
+	this->checkResponse(transfer.getData(), transferSize, transfer.wait(), checkRc);
+
 	if (bufferSize) {
-		const uint8_t *src = transferBuffer.get();
+		const uint8_t *src = transfer.getData();
 
 		if (checkRc) {
 			src++;
@@ -173,27 +507,195 @@ void rfid::device::InterfaceUsbImpl::doTransferRx(uint8_t *buffer, uint16_t buff
 }
 
 
+uint16_t rfid::device::InterfaceUsbImpl::finishTransferRxPartial(Transfer &transfer, uint8_t *buffer, uint16_t bufferSize) {
+	int returned = transfer.wait();
+
+	if ((returned < 0) || (returned > bufferSize)) {
+		this->checkResponse(transfer.getData(), bufferSize, returned, false);
+	}
+
+	memcpy(buffer, transfer.getData(), returned);
+
+	return returned;
+}
+
+
+void rfid::device::InterfaceUsbImpl::finishTransferTx(Transfer &transfer, uint16_t bufferSize) {
+	this->checkResponse(nullptr, bufferSize, transfer.wait(), false);
+}
+
+
+void rfid::device::InterfaceUsbImpl::doTransferRx(uint8_t *buffer, uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command, bool checkRc) {
+	this->finishTransferRx(*this->submitTransferRx(bufferSize, index, value, command, checkRc), buffer, bufferSize, checkRc);
+}
+
+
 void rfid::device::InterfaceUsbImpl::doTransferTx(uint8_t *buffer, uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command) {
-	this->checkConnection();
+	this->finishTransferTx(*this->submitTransferTx(buffer, bufferSize, index, value, command), bufferSize);
+}
+
+
+uint8_t rfid::device::InterfaceUsbImpl::startTransfer(uint16_t flags, uint16_t timeout) {
+	uint8_t transferId;
+
+	this->doTransferRx(&transferId, 1, flags, timeout, PROTO_CMD_TRANSFER_START, true);
+
+	Log::debug("Transfer id: %u", transferId);
+
+	return transferId;
+}
+
+
+uint16_t rfid::device::InterfaceUsbImpl::waitTransfer(uint8_t transferId, uint32_t minDurationUs, uint32_t maxDurationUs, uint16_t timeout) {
+	bool     fastDispatch = VERSION(this)->hasFastDispatch();
+	uint32_t latencyUs    = fastDispatch ? TRANSFER_LATENCY_FAST_US  : TRANSFER_LATENCY_US;
+	uint32_t pollUs       = fastDispatch ? TRANSFER_POLL_FAST_MIN_US : TRANSFER_POLL_MIN_US;
+	uint16_t count        = 0;
+
+	auto start    = std::chrono::steady_clock::now();
+	auto deadline = start + std::chrono::microseconds(minDurationUs + latencyUs);
+	auto limit    = start + std::chrono::microseconds(maxDurationUs + latencyUs + (uint32_t) timeout * PROTO_TRANSFER_EDGE_PRESCALER * CARRIER_US + TRANSFER_GUARD_US);
+
+	if (this->completionEndpoint && this->waitCompletion(transferId, limit, count)) {
+		Log::debug("Transfer %u completed after %lld us (expected %u - %u us)", transferId,
+			(long long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), minDurationUs, maxDurationUs
+		);
+
+		return count;
+	}
+
+	// Nothing to ask for before the transfer could have possibly finished
+	std::this_thread::sleep_until(deadline);
+
+	while (true) {
+		uint8_t response[3];
+
+		this->doTransferRx(response, 3, transferId, 0, PROTO_CMD_TRANSFER_STATUS, true);
 
-	this->checkResponse(nullptr, bufferSize,
-		usb_control_msg(
-			this->handle,
-			USB_TYPE_VENDOR | USB_RECIP_DEVICE | USB_ENDPOINT_OUT,
-			command,
-			value,
-			index,
-			(char *) buffer,
-			bufferSize,
-			DEFAULT_TIMEOUT
-		),
-		false
+		Log::debug("status: %u, samplesCount: %u", response[0], (response[1] << 8) | response[2]);
+
+		if (response[0] != PROTO_TRANSFER_STATUS_IN_PROGRESS) {
+			if (response[0] == PROTO_TRANSFER_STATUS_TIMEOUT) {
+				throw TimeoutException();
+
+			} else if (response[0] != PROTO_TRANSFER_STATUS_OK) {
+				throw InvalidStateException();
+			}
+
+			count = (response[1] << 8) | response[2];
+			break;
+		}
+
+		if (std::chrono::steady_clock::now() >= limit) {
+			this->abortTransfer(transferId);
+
+			throw TimeoutException();
+		}
+
+		std::this_thread::sleep_for(std::chrono::microseconds(pollUs));
+
+		pollUs = std::min<uint32_t>(pollUs * 2, TRANSFER_POLL_MAX_US);
+	}
+
+	Log::debug("Transfer %u finished after %lld us (expected %u - %u us)", transferId,
+		(long long) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count(), minDurationUs, maxDurationUs
 	);
+
+	return count;
 }
 
 
-rfid::device::InterfaceUsbImpl::InterfaceUsbImpl() {
+bool rfid::device::InterfaceUsbImpl::waitCompletion(uint8_t transferId, const std::chrono::steady_clock::time_point &limit, uint16_t &count) {
+	while (true) {
+		uint8_t record[PROTO_COMPLETION_RECORD_SIZE];
+		int     transferred = 0;
+		int     rc;
+
+		auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(limit - std::chrono::steady_clock::now()).count();
+		if (remaining <= 0) {
+			this->abortTransfer(transferId);
+
+			throw TimeoutException();
+		}
+
+		rc = libusb_interrupt_transfer(this->handle, PROTO_COMPLETION_ENDPOINT, record, sizeof(record), &transferred, (unsigned int) remaining);
+		if (rc == LIBUSB_ERROR_TIMEOUT) {
+			this->abortTransfer(transferId);
+
+			throw TimeoutException();
+
+		} else if ((rc != LIBUSB_SUCCESS) || (transferred != sizeof(record))) {
+			Log::warn("Completion endpoint failed (%s), falling back to status polling", rc != LIBUSB_SUCCESS ? libusb_error_name(rc) : "short transfer");
+
+			this->completionEndpoint = false;
+
+			return false;
+		}
+
+		Log::debug("completion id: %u, status: %u, samplesCount: %u", record[0], record[1], (record[2] << 8) | record[3]);
+
+		// Record of a stopped stream or an abandoned transfer
+		if (record[0] != transferId) {
+			continue;
+		}
+
+		if (record[1] == PROTO_TRANSFER_STATUS_TIMEOUT) {
+			throw TimeoutException();
+
+		} else if (record[1] != PROTO_TRANSFER_STATUS_OK) {
+			throw InvalidStateException();
+		}
+
+		count = (record[2] << 8) | record[3];
+
+		return true;
+	}
+}
+
+
+void rfid::device::InterfaceUsbImpl::stopTransfer(uint8_t transferId) {
+	this->doTransferRx(nullptr, 0, transferId, 0, PROTO_CMD_TRANSFER_STOP, true);
+}
+
+
+// Stops transfer the device did not finish in time, it would keep sampling otherwise
+void rfid::device::InterfaceUsbImpl::abortTransfer(uint8_t transferId) {
+	try {
+		this->stopTransfer(transferId);
+
+	} catch (const common::Exception &ex) {
+		Log::debug("Unable to stop transfer %u: %s", transferId, ex.getMessage().c_str());
+	}
+}
+
+
+uint16_t rfid::device::InterfaceUsbImpl::getStreamHalves(uint8_t transferId) {
+	return this->finishStreamStatus(*this->submitTransferRx(3, transferId, 0, PROTO_CMD_TRANSFER_STATUS, true));
+}
+
+
+uint16_t rfid::device::InterfaceUsbImpl::finishStreamStatus(Transfer &transfer) {
+	uint8_t response[3];
+
+	this->finishTransferRx(transfer, response, 3, true);
+
+	if (response[0] != PROTO_TRANSFER_STATUS_IN_PROGRESS) {
+		throw InvalidStateException();
+	}
+
+	return (response[1] << 8) | response[2];
+}
+
+
+rfid::device::InterfaceUsbImpl::InterfaceUsbImpl(const std::string &key) {
+	this->context = UsbEventLoop::acquire();
 	this->handle  = nullptr;
+	this->rxMode  = RX_MODE_BITMAP;
+
+	this->completionEndpoint = false;
+
+	this->captureDivider = 0;
+	this->captureFrames  = 0;
 
 	this->sampleBits       = 0;
 	this->sampleVectorSize = 0;
@@ -204,74 +706,72 @@ rfid::device::InterfaceUsbImpl::InterfaceUsbImpl() {
 
 	this->version.reset();
 
-	usb_find_busses();
-	usb_find_devices();
+	try {
+		_findReaders(this->context, [this, &key](libusb_device_handle *handle, const std::string &deviceKey) {
+			if (key.empty() || (key == deviceKey)) {
+				this->handle = handle;
+				this->key    = deviceKey;
 
-	{
-		struct usb_device *dev;
+				return true;
+			}
 
-		struct usb_bus *bus = usb_get_busses();
+			return false;
+		});
 
-		while (bus != NULL) {
-			usb_dev_handle *tmpHandle = NULL;
+		if (this->handle) {
+			uint8_t response[6];
 
-			dev = bus->devices;
+			for (int i = 0; i < TRANSFER_POOL_SIZE; i++) {
+				this->transfers.push_back(std::unique_ptr<Transfer>(new Transfer(this->handle)));
+			}
 
-			while (dev != NULL) {
-				if (
-					(dev->descriptor.idVendor  == DEV_USB_VID) &&
-					(dev->descriptor.idProduct == DEV_USB_PID)
-				) {
-					tmpHandle = usb_open(dev);
-					if (tmpHandle == nullptr) {
-						continue;
-					}
+			// Both requests are queued at once
+			TransferHandle versionTransfer    = this->submitTransferRx(2, 0, 0, PROTO_CMD_GET_VERSION, true);
+			TransferHandle bufferSizeTransfer = this->submitTransferRx(6, 0, 0, PROTO_CMD_GET_BUFFER_SIZE, true);
 
-					if (dev->descriptor.iProduct > 0) {
-						char iProductBuffer[255];
+			this->finishTransferRx(*versionTransfer, response, 2, true);
+			Log::debug("version: %u %u", response[0], response[1]);
+			this->version.reset(new UsbFirmwareVersion(response[0], response[1]));
 
-						if (usbGetStringAscii(tmpHandle, dev->descriptor.iProduct, iProductBuffer, sizeof(iProductBuffer)) >= 0) {
-							if (strcmp(iProductBuffer, DEV_USB_PROD) == 0) {
-								this->handle = tmpHandle;
-								break;
-							}
-						}
-					}
-				}
+			this->finishTransferRx(*bufferSizeTransfer, response, 6, true);
 
-				dev = dev->next;
-			}
+			this->pulseBits        = response[0];
+			this->sampleBits       = response[1];
+			this->pulseVectorSize  = (response[4] << 8) | response[5];
+			this->sampleVectorSize = (response[2] << 8) | response[3];
 
-			if (this->handle != nullptr) {
-				break;
-			}
+			this->pulsesMax  = (uint32_t) (this->pulseVectorSize  * 8) / this->pulseBits;
+			this->samplesMax = (uint32_t) (this->sampleVectorSize * 8) / this->sampleBits;
 
-			bus = bus->next;
-		}
-	}
+			Log::debug("Pulse - sample: %u, vector: %u, Sample - sample: %u, vector: %u",
+				this->pulseBits, this->pulseVectorSize, this->sampleBits, this->sampleVectorSize
+			);
 
-	if (this->handle) {
-		uint8_t response[6];
+			Log::log("Total pulses: %u, Total samples: %u", this->pulsesMax, this->samplesMax);
 
-		this->doTransferRx(response, 2, 0, 0, PROTO_CMD_GET_VERSION, true);
-		Log::debug("version: %u %u", response[0], response[1]);
-		this->version.reset(new UsbFirmwareVersion(response[0], response[1]));
+			this->scratch.resize(std::max(this->sampleVectorSize, this->pulseVectorSize));
 
-		this->doTransferRx(response, 6, 0, 0, PROTO_CMD_GET_BUFFER_SIZE, true);
+			if (VERSION(this)->hasCompletionEndpoint()) {
+				int rc = libusb_claim_interface(this->handle, 0);
+				if (rc == LIBUSB_SUCCESS) {
+					this->completionEndpoint = true;
 
-		this->pulseBits        = response[0];
-		this->sampleBits       = response[1];
-		this->pulseVectorSize  = (response[4] << 8) | response[5];
-		this->sampleVectorSize = (response[2] << 8) | response[3];
+				} else {
+					Log::warn("Unable to claim interface (%s), transfer status will be polled", libusb_error_name(rc));
+				}
+			}
+		}
 
-		this->pulsesMax  = (uint32_t) (this->pulseVectorSize  * 8) / this->pulseBits;
-		this->samplesMax = (uint32_t) (this->sampleVectorSize * 8) / this->sampleBits;
+	} catch (...) {
+		this->transfers.clear();
 
-		Log::debug("Pulse - sample: %u, vector: %u, Sample - sample: %u, vector: %u",
-			this->pulseBits, this->pulseVectorSize, this->sampleBits, this->sampleVectorSize
-		);
+		if (this->handle) {
+			libusb_close(this->handle);
+		}
 
-		Log::log("Total pulses: %u, Total samples: %u", this->pulsesMax, this->samplesMax);
+		UsbEventLoop::release();
+
+		throw;
 	}
 
 	Log::debug("USB device handle: %p", this->handle);
@@ -279,11 +779,41 @@ rfid::device::InterfaceUsbImpl::InterfaceUsbImpl() {
 
 
 rfid::device::InterfaceUsbImpl::~InterfaceUsbImpl() {
+	this->transfers.clear();
+
 	if (this->handle) {
-		usb_close(this->handle);
+		if (this->completionEndpoint) {
+			libusb_release_interface(this->handle, 0);
+		}
+
+		libusb_close(this->handle);
 
 		this->handle = nullptr;
 	}
+
+	UsbEventLoop::release();
+}
+
+
+std::vector<std::string> rfid::device::InterfaceUsbImpl::enumerate() {
+	std::vector<std::string> ret;
+
+	libusb_context *context = UsbEventLoop::acquire();
+
+	_findReaders(context, [&ret](libusb_device_handle *handle, const std::string &deviceKey) {
+		ret.push_back(deviceKey);
+
+		return false;
+	});
+
+	UsbEventLoop::release();
+
+	return ret;
+}
+
+
+const std::string &rfid::device::InterfaceUsbImpl::getKey() {
+	return this->key;
 }
 
 
@@ -304,71 +834,239 @@ std::shared_ptr<rfid::device::Interface::FirmwareVersion> rfid::device::Interfac
 }
 
 
-std::shared_ptr<std::vector<rfid::device::Interface::Sample>> rfid::device::InterfaceUsbImpl::getSamples() {
-	std::shared_ptr<std::vector<Sample>> ret(new std::vector<Sample>);
+void rfid::device::InterfaceUsbImpl::setRxMode(RxMode mode) {
+	this->rxMode = mode;
+}
 
-	const uint16_t prescaler = 8;
 
-	{
-		uint8_t transferId;
-
-		uint8_t response[3];
+uint16_t rfid::device::InterfaceUsbImpl::getRxPrescaler() {
+	// Buffer use of RLE captures does not depend on the sampling rate, runs are sampled finest
+	return (this->rxMode == RX_MODE_RLE) ? PROTO_TRANSFER_EDGE_PRESCALER : RX_PRESCALER;
+}
 
-		// Start sampler
-		this->doTransferRx(
-			response,
-			1,
-			PROTO_TRANSFER_FLAG_FIRST_ON_START | PROTO_TRANSFER_FLAG_START_ON_EDGE | PROTO_TRANSFER_FLAG_FALLING_EDGE | prescaler, // prescaler
-			60000,
-			PROTO_CMD_TRANSFER_START,
-			true
-		);
 
-		transferId = response[0];
+uint16_t rfid::device::InterfaceUsbImpl::getRunUnit(uint16_t prescaler) {
+	// Edge timing runs are measured directly in carrier periods
+	return (this->rxMode == RX_MODE_EDGE_TIMING) ? 1 : prescaler;
+}
 
-		Log::debug("Transfer id: %u", transferId);
 
-		usleep(500 * 1000);
+uint16_t rfid::device::InterfaceUsbImpl::getCaptureSize(uint16_t prescaler) {
+	uint32_t ret = this->sampleVectorSize;
 
-		// Check status
-		this->doTransferRx(response, 3, transferId, 0, PROTO_CMD_TRANSFER_STATUS, true);
+	if ((this->captureFrames != 0) && VERSION(this)->hasCaptureLength()) {
+		// Capture starts anywhere in a frame, one more frame makes sure the requested frames are whole
+		uint32_t bits = (uint32_t) (this->captureFrames + 1) * CAPTURE_FRAME_BITS;
 
-		Log::debug("status: %u, samplesCount: %u", response[0], (response[1] << 8) | response[2]);
+		if (this->rxMode != RX_MODE_BITMAP) {
+			// Every half bit is a separate run in the worst case
+			ret = bits * 2;
 
-		if (response[0] != PROTO_TRANSFER_STATUS_OK) {
-			throw InvalidStateException();
+		} else {
+			ret = (bits * this->captureDivider / prescaler + 7) / 8;
 		}
 	}
 
+	return std::min<uint32_t>(ret, this->sampleVectorSize);
+}
+
+
+uint8_t rfid::device::InterfaceUsbImpl::startSampling(uint16_t prescaler, uint16_t timeout, uint16_t &captureSize, uint32_t &minDurationUs, uint32_t &maxDurationUs) {
+	uint16_t flags = PROTO_TRANSFER_FLAG_FIRST_ON_START | PROTO_TRANSFER_FLAG_START_ON_EDGE | PROTO_TRANSFER_FLAG_FALLING_EDGE | prescaler;
+
+	if ((this->rxMode == RX_MODE_RLE) && ! VERSION(this)->hasRle()) {
+		throw NotSupportedInterfaceException();
+	}
+
+	if ((this->rxMode == RX_MODE_EDGE_TIMING) && ! VERSION(this)->hasEdgeTiming()) {
+		throw NotSupportedInterfaceException();
+	}
+
+	captureSize = this->getCaptureSize(prescaler);
+
+	if (this->rxMode == RX_MODE_EDGE_TIMING) {
+		flags |= PROTO_TRANSFER_FLAG_EDGE_TIMING;
+
+		// Runs are measured in carrier periods, split after PROTO_RLE_LENGTH_MASK of them
+		minDurationUs = (uint32_t) captureSize * 8 * CARRIER_US;
+		maxDurationUs = (uint32_t) captureSize * PROTO_RLE_LENGTH_MASK * CARRIER_US;
+
+	} else if (this->rxMode == RX_MODE_RLE) {
+		flags |= PROTO_TRANSFER_FLAG_RLE;
+
+		// Capture length depends on the signal, between a transition on every sample and
+		// the longest runs. RF/16 half bits are the shortest runs expected from a token.
+		minDurationUs = (uint32_t) captureSize * 8 * CARRIER_US;
+		maxDurationUs = (uint32_t) captureSize * PROTO_RLE_LENGTH_MASK * prescaler * CARRIER_US;
+
+	} else {
+		minDurationUs = (uint32_t) captureSize * 8 * prescaler * CARRIER_US;
+		maxDurationUs = minDurationUs;
+	}
+
+	if (captureSize < this->sampleVectorSize) {
+		Log::debug("Capture window: %u of %u bytes", captureSize, this->sampleVectorSize);
+
+		flags |= PROTO_TRANSFER_FLAG_LENGTH;
+
+		// Timeout is passed in units of 256 samples
+		timeout = (captureSize << 8) | std::min((timeout + 255) >> 8, 0xff);
+	}
+
+	return this->startTransfer(flags, timeout);
+}
+
+
+void rfid::device::InterfaceUsbImpl::setCaptureWindow(uint8_t carrierDivider, uint8_t frames) {
+	this->captureDivider = carrierDivider;
+	this->captureFrames  = (carrierDivider != 0) ? frames : 0;
+}
+
+
+void rfid::device::InterfaceUsbImpl::getSamples(std::vector<Sample> &samples) {
+	const uint16_t prescaler = this->getRxPrescaler();
+	const uint16_t timeout   = 60000;
+
+	uint16_t samplesCount;
+	uint16_t captureSize;
+
+	samples.clear();
+
+	this->checkConnection();
+
+	{
+		uint32_t minDurationUs;
+		uint32_t maxDurationUs;
+
+		uint8_t transferId = this->startSampling(prescaler, timeout, captureSize, minDurationUs, maxDurationUs);
+
+		samplesCount = this->waitTransfer(transferId, minDurationUs, maxDurationUs, timeout);
+	}
+
 	// Read samples
 	{
-		uint8_t samplesBuffer[this->sampleVectorSize];
+		uint8_t *samplesBuffer = this->scratch.data();
 
-		this->doTransferRx(samplesBuffer, this->sampleVectorSize, 0, 0, PROTO_CMD_PULSE_VECTOR_READ, false);
+		this->doTransferRx(samplesBuffer, captureSize, 0, 0, PROTO_CMD_PULSE_VECTOR_READ, false);
 
-		int currentState       = -1;
-		int currentStateLength = 0;
+		// Every RLE entry or bitmap bit produces at most one sample
+		if (this->rxMode != RX_MODE_BITMAP) {
+			samples.reserve(captureSize);
 
-		for (int i = 0; i < this->sampleVectorSize; i++) {
-			for (int j = 0; j < 8; j++) {
-				int lastState = currentState;
+			RleDecoder(this->getRunUnit(prescaler)).decode(samplesBuffer, std::min(samplesCount, captureSize), samples);
 
-				currentState = (samplesBuffer[i] & (1 << j)) != 0;
-				if (currentState != lastState) {
-					if (lastState != -1) {
-						ret->push_back(Sample(currentStateLength * CARRIER_US * prescaler, ! lastState));
+		} else {
+			samples.reserve(captureSize * 8);
 
-						currentStateLength = 1;
-					}
+			BitmapDecoder(prescaler).decode(samplesBuffer, captureSize, samples);
+		}
+	}
+}
+
+
+void rfid::device::InterfaceUsbImpl::getSamples(std::vector<Sample> &samples, const std::function<bool(const std::vector<Sample> &samples)> &isDone) {
+	const uint16_t prescaler = this->getRxPrescaler();
+	const uint16_t timeout   = 60000;
+
+	this->checkConnection();
+
+	if (! VERSION(this)->hasRangedRead()) {
+		Interface::getSamples(samples, isDone);
+		return;
+	}
+
+	uint16_t captureSize;
+	uint32_t minDurationUs;
+	uint32_t maxDurationUs;
+
+	uint8_t transferId = this->startSampling(prescaler, timeout, captureSize, minDurationUs, maxDurationUs);
+
+	samples.clear();
+	samples.reserve(this->rxMode != RX_MODE_BITMAP ? captureSize : captureSize * 8);
+
+	try {
+		BitmapDecoder bitmapDecoder(prescaler);
+		RleDecoder    rleDecoder(this->getRunUnit(prescaler));
+		uint8_t      *buffer   = this->scratch.data();
+		uint16_t      offset   = 0;
+		bool          finished = false;
+
+		uint32_t pollUs = std::max<uint32_t>(minDurationUs / RANGE_READ_PARTS, TRANSFER_POLL_FAST_MIN_US);
+
+		auto limit = std::chrono::steady_clock::now() + std::chrono::microseconds(
+			maxDurationUs + TRANSFER_LATENCY_FAST_US + (uint32_t) timeout * PROTO_TRANSFER_EDGE_PRESCALER * CARRIER_US + TRANSFER_GUARD_US
+		);
+
+		while (! finished) {
+			uint8_t  status[3];
+			uint16_t read = 0;
+
+			std::this_thread::sleep_for(std::chrono::microseconds(pollUs));
+
+			// Status is queued in front of the read, so the read of a finished transfer returns all data
+			{
+				TransferHandle statusTransfer = this->submitTransferRx(3, transferId, 0, PROTO_CMD_TRANSFER_STATUS, true);
+
+				if (offset < captureSize) {
+					TransferHandle readTransfer = this->submitTransferRx(
+						captureSize - offset, offset, captureSize - offset, PROTO_CMD_SAMPLE_RANGE_READ, false
+					);
+
+					this->finishTransferRx(*statusTransfer, status, 3, true);
+
+					read = this->finishTransferRxPartial(*readTransfer, buffer + offset, captureSize - offset);
 
 				} else {
-					currentStateLength++;
+					this->finishTransferRx(*statusTransfer, status, 3, true);
 				}
 			}
+
+			Log::debug("status: %u, samplesCount: %u, read: %u", status[0], (status[1] << 8) | status[2], read);
+
+			if (status[0] == PROTO_TRANSFER_STATUS_TIMEOUT) {
+				throw TimeoutException();
+
+			} else if ((status[0] != PROTO_TRANSFER_STATUS_OK) && (status[0] != PROTO_TRANSFER_STATUS_IN_PROGRESS)) {
+				throw InvalidStateException();
+			}
+
+			finished = status[0] != PROTO_TRANSFER_STATUS_IN_PROGRESS;
+
+			if (read > 0) {
+				if (this->rxMode != RX_MODE_BITMAP) {
+					rleDecoder.decode(buffer + offset, read, samples);
+
+				} else {
+					bitmapDecoder.decode(buffer + offset, read, samples);
+				}
+
+				offset += read;
+
+				if (isDone(samples)) {
+					if (! finished) {
+						Log::debug("Transfer %u stopped after %u of %u bytes", transferId, offset, captureSize);
+
+						this->stopTransfer(transferId);
+					}
+
+					return;
+				}
+			}
+
+			if (! finished && (std::chrono::steady_clock::now() >= limit)) {
+				throw TimeoutException();
+			}
 		}
-	}
 
-	return ret;
+	} catch (...) {
+		try {
+			this->stopTransfer(transferId);
+
+		} catch (...) {
+		}
+
+		throw;
+	}
 }
 
 
@@ -376,7 +1074,7 @@ void rfid::device::InterfaceUsbImpl::putSamples(const std::vector<Sample> &sampl
 	std::set<int> pulses;
 
 	for (auto sample : samples) {
-		pulses.insert(sample.getLengthUs() / CARRIER_US);
+		pulses.insert(sample.getLengthCarriers());
 	}
 
 	Log::debug("Different pulses count: %zd, samples number: %zd", pulses.size(), samples.size());
@@ -385,73 +1083,157 @@ void rfid::device::InterfaceUsbImpl::putSamples(const std::vector<Sample> &sampl
 		throw TooManyPulsesException();
 	}
 
-	// Set pulse vector
+	// Pulse vector, sample vector and transfer start are queued at once
 	{
-		uint8_t buffer[this->pulseVectorSize];
-		uint8_t bufferWritten = 0;
+		const uint16_t timeout = 60000;
 
-		memset(buffer, 0, this->pulseVectorSize);
+		uint8_t  pulseBuffer[this->pulseVectorSize];
+		uint8_t  pulseBufferWritten = 0;
+		uint8_t  sampleBuffer[this->sampleVectorSize];
+		uint16_t sampleBufferWritten = 0;
+		uint32_t durationUs = 0;
+
+		memset(pulseBuffer, 0, this->pulseVectorSize);
 
 		for (auto pulse : pulses) {
-			buffer[bufferWritten++] = pulse;
+			pulseBuffer[pulseBufferWritten++] = pulse;
 		}
 
-		this->doTransferTx(buffer, this->pulseVectorSize, 0, 0, PROTO_CMD_SAMPLE_VECTOR_WRITE);
-	}
-
-	// Set sample vector
-	{
-		uint8_t  buffer[this->sampleVectorSize];
-		uint16_t bufferSamplesWritten = 0;
-
-		memset(buffer, 0xff, this->sampleVectorSize);
+		memset(sampleBuffer, 0xff, this->sampleVectorSize);
 
 		for (auto sample : samples) {
-			uint8_t value = (sample.isLow() ? 0 : 0x08) | std::distance(pulses.begin(), pulses.find(sample.getLengthUs() / CARRIER_US));
+			uint8_t value = (sample.isLow() ? 0 : 0x08) | std::distance(pulses.begin(), pulses.find(sample.getLengthCarriers()));
 
-			if (bufferSamplesWritten & 1) {
-				buffer[bufferSamplesWritten >> 1] |= (value << 4);
+			if (sampleBufferWritten & 1) {
+				sampleBuffer[sampleBufferWritten >> 1] |= (value << 4);
 
 			} else {
-				buffer[bufferSamplesWritten >> 1]  = value;
+				sampleBuffer[sampleBufferWritten >> 1]  = value;
 			}
 
-			bufferSamplesWritten++;
+			sampleBufferWritten++;
+
+			durationUs += sample.getLengthUs();
 		}
 
-		this->doTransferTx(buffer, this->sampleVectorSize, 0, 0, PROTO_CMD_PULSE_VECTOR_WRITE);
+		TransferHandle pulseTransfer  = this->submitTransferTx(pulseBuffer,  this->pulseVectorSize,  0, 0, PROTO_CMD_SAMPLE_VECTOR_WRITE);
+		TransferHandle sampleTransfer = this->submitTransferTx(sampleBuffer, this->sampleVectorSize, 0, 0, PROTO_CMD_PULSE_VECTOR_WRITE);
+		TransferHandle startTransfer  = this->submitTransferRx(
+			1,
+			PROTO_TRANSFER_FLAG_TX_MODE | PROTO_TRANSFER_FLAG_START_ON_EDGE | PROTO_TRANSFER_FLAG_FALLING_EDGE | PROTO_TRANSFER_FLAG_FIRST_ON_START | 8, // prescaller
+			timeout,
+			PROTO_CMD_TRANSFER_START,
+			true
+		);
 
+		uint8_t transferId;
 
-		// Start transfer
-		{
-			uint8_t transferId;
-
-			uint8_t response[3];
-
-			// Start sampler
-			this->doTransferRx(
-				response,
-				1,
-				PROTO_TRANSFER_FLAG_TX_MODE | PROTO_TRANSFER_FLAG_START_ON_EDGE | PROTO_TRANSFER_FLAG_FALLING_EDGE | PROTO_TRANSFER_FLAG_FIRST_ON_START | 8, // prescaller
-				60000 * CARRIER_US,
-				PROTO_CMD_TRANSFER_START,
-				true
-			);
+		this->finishTransferTx(*pulseTransfer,  this->pulseVectorSize);
+		this->finishTransferTx(*sampleTransfer, this->sampleVectorSize);
+		this->finishTransferRx(*startTransfer, &transferId, 1, true);
 
-			transferId = response[0];
+		Log::debug("Transfer id: %u", transferId);
 
-			Log::debug("Transfer id: %u", transferId);
+		this->waitTransfer(transferId, durationUs, durationUs, timeout);
+	}
+}
 
-			usleep(500 * 1000);
 
-			// Check status
-			this->doTransferRx(response, 3, transferId, 0, PROTO_CMD_TRANSFER_STATUS, true);
+bool rfid::device::InterfaceUsbImpl::isStreamingSupported() {
+	this->checkConnection();
 
-			Log::debug("status: %u, samplesCount: %u", response[0], (response[1] << 8) | response[2]);
+	return VERSION(this)->hasStreaming();
+}
 
-			if (response[0] != PROTO_TRANSFER_STATUS_OK) {
-				throw InvalidStateException();
+
+void rfid::device::InterfaceUsbImpl::streamSamples(common::RingBuffer<Sample> &ring, const std::function<bool()> &isDone) {
+	const uint16_t prescaler = RX_PRESCALER;
+	const uint16_t halfSize  = this->sampleVectorSize / 2;
+	const uint32_t halfUs    = (uint32_t) halfSize * 8 * prescaler * CARRIER_US;
+
+	this->checkConnection();
+
+	if (! VERSION(this)->hasStreaming()) {
+		throw NotSupportedInterfaceException();
+	}
+
+	uint8_t transferId = this->startTransfer(PROTO_TRANSFER_FLAG_STREAM | PROTO_TRANSFER_FLAG_FIRST_ON_START | prescaler, 0);
+
+	try {
+		BitmapDecoder       decoder(prescaler);
+		std::vector<Sample> samples;
+		uint8_t            *halfBuffer = this->scratch.data();
+		uint16_t            sequence = 0;
+		bool                gap      = false;
+
+		while (! isDone()) {
+			uint16_t halves = this->getStreamHalves(transferId);
+
+			if (halves == sequence) {
+				std::this_thread::sleep_for(std::chrono::microseconds(halfUs / 4));
+				continue;
+			}
+
+			// Oldest half was already overwritten, continue with the newest one
+			if ((uint16_t) (halves - sequence) > 1) {
+				Log::debug("Stream overrun, lost halves: %u", (uint16_t) (halves - sequence - 1));
+
+				sequence = halves - 1;
+				gap      = true;
+			}
+
+			// Half could have been overwritten while it was read, status is queued right behind the read
+			{
+				TransferHandle readTransfer   = this->submitTransferRx(halfSize, sequence, 0, PROTO_CMD_STREAM_READ, false);
+				TransferHandle statusTransfer = this->submitTransferRx(3, transferId, 0, PROTO_CMD_TRANSFER_STATUS, true);
+
+				this->finishTransferRx(*readTransfer, halfBuffer, halfSize, false);
+
+				halves = this->finishStreamStatus(*statusTransfer);
+			}
+
+			if ((uint16_t) (halves - sequence) > 1) {
+				Log::debug("Stream overrun during read of half %u", sequence);
+
+				sequence = halves - 1;
+				gap      = true;
+				continue;
 			}
+
+			sequence++;
+
+			if (gap) {
+				if (! ring.push(Sample())) {
+					continue;
+				}
+
+				decoder.reset();
+
+				gap = false;
+			}
+
+			samples.clear();
+			decoder.decode(halfBuffer, halfSize, samples);
+
+			for (const auto &sample : samples) {
+				if (! ring.push(sample)) {
+					Log::debug("Ring buffer is full, dropping samples");
+
+					gap = true;
+					break;
+				}
+			}
+		}
+
+	} catch (...) {
+		try {
+			this->stopTransfer(transferId);
+
+		} catch (...) {
 		}
+
+		throw;
 	}
+
+	this->stopTransfer(transferId);
 }
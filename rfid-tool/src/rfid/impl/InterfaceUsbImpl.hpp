@@ -15,7 +15,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <usb.h>
+#include <chrono>
+
+#include <libusb.h>
 
 #include "rfid/Interface.hpp"
 
@@ -23,24 +25,32 @@
 namespace rfid {
 	namespace device {
 		class InterfaceUsbImpl : public rfid::device::Interface {
-			private:
-				static class _init {
-					public:
-						_init() {
-							usb_init();
-						}
-				} _initializer;
+			public:
+				// Asynchronous control transfer, completed by the shared USB event thread
+				class Transfer;
+				// Owns a transfer taken from the pool, returns it to the pool when destroyed
+				class TransferHandle;
 
 			public:
-				InterfaceUsbImpl();
+				// Opens reader identified by the key or the first one found when key is empty
+				InterfaceUsbImpl(const std::string &key = "");
 				virtual ~InterfaceUsbImpl();
 
+				static std::vector<std::string> enumerate();
+
+				virtual const std::string &getKey();
 				virtual bool isConnected();
 				virtual void reset();
 				virtual std::shared_ptr<FirmwareVersion> getVersion();
 //				virtual void coilEnable(bool enable);
-				std::shared_ptr<std::vector<Sample>> getSamples();
+				virtual void setRxMode(RxMode mode);
+				virtual void setCaptureWindow(uint8_t carrierDivider, uint8_t frames);
+				using Interface::getSamples;
+				virtual void getSamples(std::vector<Sample> &samples);
+				virtual void getSamples(std::vector<Sample> &samples, const std::function<bool(const std::vector<Sample> &samples)> &isDone);
 				virtual void putSamples(const std::vector<Sample> &samples);
+				virtual bool isStreamingSupported();
+				virtual void streamSamples(common::RingBuffer<Sample> &ring, const std::function<bool()> &isDone);
 
 			protected:
 				void checkConnection();
@@ -48,9 +58,42 @@ namespace rfid {
 				void doTransferRx(uint8_t *buffer, uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command, bool checkRc);
 				void doTransferTx(uint8_t *buffer, uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command);
 
+				TransferHandle acquireTransfer();
+				TransferHandle submitTransferRx(uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command, bool checkRc);
+				TransferHandle submitTransferTx(const uint8_t *buffer, uint16_t bufferSize, uint16_t index, uint16_t value, uint8_t command);
+				void finishTransferRx(Transfer &transfer, uint8_t *buffer, uint16_t bufferSize, bool checkRc);
+				uint16_t finishTransferRxPartial(Transfer &transfer, uint8_t *buffer, uint16_t bufferSize);
+				void finishTransferTx(Transfer &transfer, uint16_t bufferSize);
+
+				uint8_t startTransfer(uint16_t flags, uint16_t timeout);
+				uint16_t getRxPrescaler();
+				uint16_t getRunUnit(uint16_t prescaler);
+				uint16_t getCaptureSize(uint16_t prescaler);
+				uint8_t startSampling(uint16_t prescaler, uint16_t timeout, uint16_t &captureSize, uint32_t &minDurationUs, uint32_t &maxDurationUs);
+				uint16_t waitTransfer(uint8_t transferId, uint32_t minDurationUs, uint32_t maxDurationUs, uint16_t timeout);
+				bool waitCompletion(uint8_t transferId, const std::chrono::steady_clock::time_point &limit, uint16_t &count);
+				void stopTransfer(uint8_t transferId);
+				void abortTransfer(uint8_t transferId);
+				uint16_t getStreamHalves(uint8_t transferId);
+				uint16_t finishStreamStatus(Transfer &transfer);
+
 			private:
-				struct usb_dev_handle *handle;
+				libusb_context       *context;
+				libusb_device_handle *handle;
+				std::string           key;
 				std::shared_ptr<FirmwareVersion> version;
+				RxMode rxMode;
+
+				// Transfer completion is read from the interrupt endpoint instead of polling its status
+				bool completionEndpoint;
+
+				// Captures are shortened to hold this many frames at the divider, 0 - whole buffer
+				uint8_t captureDivider;
+				uint8_t captureFrames;
+
+				// Preallocated transfers and receive buffer, reused by every request
+				std::vector<std::unique_ptr<Transfer>> transfers;
+				std::vector<uint8_t>                   scratch;
 
 				uint16_t pulsesMax;
 				uint16_t pulseVectorSize;
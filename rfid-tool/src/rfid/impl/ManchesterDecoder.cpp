@@ -39,45 +39,9 @@ void rfid::ManchesterDecoder::reset() {
 
 void rfid::ManchesterDecoder::onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
 	if (eventId == rfid::CarrierDecoder::EVENT_NEW_PULSE) {
-		rfid::CarrierDecoder::EventPulseData *data = reinterpret_cast<rfid::CarrierDecoder::EventPulseData*>(eventData);
+		NotifierSink sink(*this);
 
-		if (this->timerRunning) {
-			this->ffOut        = data->isHigh;
-			this->timerRunning = data->isLong;
-
-			{
-				EventBitData eventData;
-
-				eventData.isOne = this->ffOut;
-
-				this->notify(EVENT_NEW_BIT, &eventData);
-			}
-
-			if (this->timerRunning) {
-				this->timerRunning = this->ffOut ^ (data->isHigh);
-			}
-
-		} else {
-			bool timerTrigger = data->isHigh ^ this->ffOut;
-
-			if (timerTrigger) {
-				if (data->isLong) {
-					this->timerRunning = false;
-					this->ffOut        = data->isHigh;
-
-					{
-						EventBitData eventData;
-
-						eventData.isOne = this->ffOut;
-
-						this->notify(EVENT_NEW_BIT, &eventData);
-					}
-
-				} else {
-					this->timerRunning = true;
-				}
-			}
-		}
+		this->decodePulse(*reinterpret_cast<rfid::CarrierDecoder::EventPulseData*>(eventData), sink);
 
 	} else if (eventId == rfid::CarrierDecoder::EVENT_SYNC_CHANGED) {
 		this->reset();
@@ -0,0 +1,439 @@
+/*
+ * Copyright (C) 2018  Jaroslaw Bielski (bielski.j@gmail.com)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+
+#include "rfid/librfid.h"
+#include "rfid/Interface.hpp"
+#include "rfid/BitmapDecoder.hpp"
+#include "rfid/InterfaceFactory.hpp"
+#include "rfid/DecoderBank.hpp"
+#include "rfid/TokenVoter.hpp"
+#include "rfid/Em4100Writer.hpp"
+#include "rfid/T5557Encoder.hpp"
+
+#include "common/Log.hpp"
+
+
+static void _fillToken(const rfid::DecoderBank::EventNewTokenData &data, rfid_token &token) {
+	token.carrier_divider = data.carrierDivider;
+	token.modulation      = (data.modulation == rfid::DecoderBank::MODULATION_BIPHASE) ? RFID_MODULATION_BIPHASE : RFID_MODULATION_MANCHESTER;
+	token.customer_id     = data.versionOrCustomerId;
+	token.data            = data.data;
+}
+
+
+struct rfid_decoder : public common::Listener {
+	rfid::DecoderBank decoderBank;
+
+	// Output of the current rfid_decoder_feed() call
+	rfid_token *tokens;
+	size_t      tokensCapacity;
+	size_t      tokensCount;
+	size_t      tokensFound;
+
+	// Reused between calls to avoid allocation on every feed
+	std::vector<rfid::device::Interface::Sample> samples;
+
+	rfid_decoder() {
+		this->tokens         = nullptr;
+		this->tokensCapacity = 0;
+		this->tokensCount    = 0;
+		this->tokensFound    = 0;
+
+		this->decoderBank.addListener(this);
+	}
+
+	virtual ~rfid_decoder() {
+		this->decoderBank.removeListener(this);
+	}
+
+	void onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+		if (eventId == rfid::DecoderBank::EVENT_NEW_TOKEN) {
+			rfid::DecoderBank::EventNewTokenData *data = reinterpret_cast<rfid::DecoderBank::EventNewTokenData *>(eventData);
+
+			if (this->tokensCount < this->tokensCapacity) {
+				_fillToken(*data, this->tokens[this->tokensCount++]);
+			}
+
+			this->tokensFound++;
+		}
+	}
+
+	int feed(const std::vector<rfid::device::Interface::Sample> &samples, rfid_token *tokens, size_t capacity, size_t *count) {
+		this->tokens         = tokens;
+		this->tokensCapacity = capacity;
+		this->tokensCount    = 0;
+		this->tokensFound    = 0;
+
+		this->decoderBank.checkPulses(samples);
+
+		this->tokens = nullptr;
+
+		if (count != nullptr) {
+			*count = this->tokensCount;
+		}
+
+		if (this->tokensFound > this->tokensCount) {
+			return RFID_ERR_BUFFER_TOO_SMALL;
+		}
+
+		return RFID_OK;
+	}
+};
+
+
+struct rfid_reader : public common::Listener {
+	std::unique_ptr<rfid::device::Interface> iface;
+
+	rfid_decoder     decoder;
+	rfid::TokenVoter voter;
+
+	// Token confirmed by the voter in current rfid_read_token() call
+	rfid_token *token;
+
+	// Reused by every capture
+	std::vector<rfid::device::Interface::Sample> samples;
+
+	rfid_reader() {
+		this->token = nullptr;
+
+		this->decoder.decoderBank.addListener(&this->voter);
+		this->voter.addListener(this);
+	}
+
+	virtual ~rfid_reader() {
+		this->voter.removeListener(this);
+		this->decoder.decoderBank.removeListener(&this->voter);
+	}
+
+	void onEvent(common::Notifier &notifier, const int eventId, void *eventData) {
+		if ((eventId == rfid::TokenVoter::EVENT_NEW_TOKEN) && (this->token != nullptr)) {
+			_fillToken(*reinterpret_cast<rfid::TokenVoter::EventNewTokenData *>(eventData)->token, *this->token);
+
+			// Only the first confirmed token is interesting
+			this->token = nullptr;
+		}
+	}
+};
+
+
+template <typename F>
+static int _call(F func) {
+	try {
+		return func();
+
+	} catch (const rfid::device::Interface::NotConnectedException &ex) {
+		return RFID_ERR_NOT_CONNECTED;
+
+	} catch (const rfid::device::Interface::TimeoutException &ex) {
+		return RFID_ERR_TIMEOUT;
+
+	} catch (const common::Exception &ex) {
+		common::Log::error("librfid: %s", ex.getMessage().c_str());
+
+		return RFID_ERR_DEVICE;
+
+	} catch (...) {
+		return RFID_ERR_INTERNAL;
+	}
+}
+
+
+int rfid_api_version(void) {
+	return RFID_API_VERSION;
+}
+
+
+const char *rfid_strerror(int error) {
+	switch (error) {
+		case RFID_OK:                   return "Success";
+		case RFID_ERR_INVALID_ARG:      return "Invalid argument";
+		case RFID_ERR_NOT_CONNECTED:    return "Reader not connected";
+		case RFID_ERR_TIMEOUT:          return "Timeout";
+		case RFID_ERR_DEVICE:           return "Device error";
+		case RFID_ERR_NO_TOKEN:         return "No token found";
+		case RFID_ERR_BUFFER_TOO_SMALL: return "Buffer too small";
+		case RFID_ERR_INTERNAL:         return "Internal error";
+
+		default:
+			break;
+	}
+
+	return "Unknown error";
+}
+
+
+int rfid_enumerate(char *buffer, size_t buffer_size, size_t *count) {
+	if ((buffer == nullptr && buffer_size != 0) || count == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		size_t offset = 0;
+
+		*count = 0;
+
+		for (const auto &key : rfid::device::InterfaceFactory::enumerate(rfid::device::InterfaceFactory::TYPE_USB)) {
+			if (offset + key.size() + 1 > buffer_size) {
+				return RFID_ERR_BUFFER_TOO_SMALL;
+			}
+
+			memcpy(buffer + offset, key.c_str(), key.size() + 1);
+
+			offset += key.size() + 1;
+			(*count)++;
+		}
+
+		return RFID_OK;
+	});
+}
+
+
+int rfid_open(const char *key, rfid_reader **reader) {
+	if (reader == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	*reader = nullptr;
+
+	return _call([&]() {
+		std::unique_ptr<rfid_reader> ret(new rfid_reader());
+
+		ret->iface.reset(rfid::device::InterfaceFactory::newInstance(rfid::device::InterfaceFactory::TYPE_USB, key ? key : ""));
+		if (! ret->iface->isConnected()) {
+			return RFID_ERR_NOT_CONNECTED;
+		}
+
+		*reader = ret.release();
+
+		return RFID_OK;
+	});
+}
+
+
+void rfid_close(rfid_reader *reader) {
+	delete reader;
+}
+
+
+int rfid_get_version(rfid_reader *reader, uint8_t *major, uint8_t *minor) {
+	if (reader == nullptr || major == nullptr || minor == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		std::shared_ptr<rfid::device::Interface::FirmwareVersion> version = reader->iface->getVersion();
+
+		*major = version->getMajor();
+		*minor = version->getMinor();
+
+		return RFID_OK;
+	});
+}
+
+
+int rfid_set_rx_mode(rfid_reader *reader, int rx_mode) {
+	if (reader == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		switch (rx_mode) {
+			case RFID_RX_MODE_BITMAP:      reader->iface->setRxMode(rfid::device::Interface::RX_MODE_BITMAP);      break;
+			case RFID_RX_MODE_RLE:         reader->iface->setRxMode(rfid::device::Interface::RX_MODE_RLE);         break;
+			case RFID_RX_MODE_EDGE_TIMING: reader->iface->setRxMode(rfid::device::Interface::RX_MODE_EDGE_TIMING); break;
+
+			default:
+				return RFID_ERR_INVALID_ARG;
+		}
+
+		return RFID_OK;
+	});
+}
+
+
+int rfid_capture(rfid_reader *reader, rfid_sample *samples, size_t capacity, size_t *count) {
+	if (reader == nullptr || (samples == nullptr && capacity != 0) || count == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		std::vector<rfid::device::Interface::Sample> &captured = reader->samples;
+
+		reader->iface->getSamples(captured);
+
+		size_t toCopy = std::min(captured.size(), capacity);
+
+		for (size_t i = 0; i < toCopy; i++) {
+			const rfid::device::Interface::Sample &sample = captured[i];
+
+			samples[i].length_us = sample.getLengthUs();
+			samples[i].high      = sample.isLow() ? 0 : 1;
+		}
+
+		*count = captured.size();
+
+		return (toCopy < captured.size()) ? RFID_ERR_BUFFER_TOO_SMALL : RFID_OK;
+	});
+}
+
+
+int rfid_read_token(rfid_reader *reader, unsigned max_captures, rfid_token *token) {
+	if (reader == nullptr || token == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		// Votes are collected across captures, reading stops once enough frames agree
+		reader->voter.reset();
+		reader->token = token;
+
+		for (unsigned i = 0; (i < max_captures) && ! reader->voter.isConfident(); i++) {
+			size_t decoded = 0;
+
+			reader->decoder.decoderBank.restart();
+
+			// Capture is stopped as soon as enough frames agree
+			try {
+				reader->iface->getSamples(reader->samples, [reader, &decoded](const std::vector<rfid::device::Interface::Sample> &samples) {
+					reader->decoder.decoderBank.checkPulses(samples.data() + decoded, samples.size() - decoded);
+
+					decoded = samples.size();
+
+					return reader->voter.isConfident();
+				});
+
+			} catch (const rfid::device::Interface::TimeoutException &ex) {
+				// No signal in the field
+				continue;
+			}
+		}
+
+		reader->token = nullptr;
+
+		return reader->voter.isConfident() ? RFID_OK : RFID_ERR_NO_TOKEN;
+	});
+}
+
+
+int rfid_set_votes(rfid_reader *reader, unsigned votes) {
+	if (reader == nullptr || votes == 0 || votes > UINT8_MAX) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	reader->voter.setVotesRequired(votes);
+
+	return RFID_OK;
+}
+
+
+int rfid_decode_bitmap(const uint8_t *bitmap, size_t bitmap_size, uint16_t prescaler, rfid_sample *samples, size_t capacity, size_t *count) {
+	if ((bitmap == nullptr && bitmap_size != 0) || prescaler == 0 || (samples == nullptr && capacity != 0) || count == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		// Every bitmap byte yields at most 8 samples
+		const size_t chunkSize = 32;
+
+		rfid::device::BitmapDecoder     decoder(prescaler);
+		rfid::device::Interface::Sample chunk[chunkSize * 8];
+
+		*count = 0;
+
+		for (size_t offset = 0; offset < bitmap_size; offset += chunkSize) {
+			size_t decoded = decoder.decode(bitmap + offset, std::min(chunkSize, bitmap_size - offset), chunk, chunkSize * 8);
+
+			for (size_t i = 0; i < decoded; i++, (*count)++) {
+				if (*count < capacity) {
+					samples[*count].length_us = chunk[i].getLengthUs();
+					samples[*count].high      = chunk[i].isLow() ? 0 : 1;
+				}
+			}
+		}
+
+		return (*count > capacity) ? RFID_ERR_BUFFER_TOO_SMALL : RFID_OK;
+	});
+}
+
+
+int rfid_write_token(rfid_reader *reader, uint8_t carrier_divider, uint8_t modulation, uint8_t customer_id, uint32_t data) {
+	rfid::T5557Encoder::DataRate   dataRate;
+	rfid::T5557Encoder::Modulation tokenModulation;
+
+	if (reader == nullptr || ! rfid::T5557Encoder::getDataRate(carrier_divider, dataRate)) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	switch (modulation) {
+		case RFID_MODULATION_MANCHESTER: tokenModulation = rfid::T5557Encoder::MODULATION_MANCHESTER; break;
+		case RFID_MODULATION_BIPHASE:    tokenModulation = rfid::T5557Encoder::MODULATION_BIPHASE;    break;
+
+		default:
+			return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		rfid::Em4100Writer::write(*reader->iface, dataRate, tokenModulation, customer_id, data);
+
+		return RFID_OK;
+	});
+}
+
+
+int rfid_decoder_new(rfid_decoder **decoder) {
+	if (decoder == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	*decoder = new (std::nothrow) rfid_decoder();
+
+	return (*decoder != nullptr) ? RFID_OK : RFID_ERR_INTERNAL;
+}
+
+
+void rfid_decoder_free(rfid_decoder *decoder) {
+	delete decoder;
+}
+
+
+void rfid_decoder_reset(rfid_decoder *decoder) {
+	if (decoder != nullptr) {
+		decoder->decoderBank.reset();
+	}
+}
+
+
+int rfid_decoder_feed(rfid_decoder *decoder, const rfid_sample *samples, size_t samples_count, rfid_token *tokens, size_t capacity, size_t *count) {
+	if (decoder == nullptr || (samples == nullptr && samples_count != 0) || (tokens == nullptr && capacity != 0) || count == nullptr) {
+		return RFID_ERR_INVALID_ARG;
+	}
+
+	return _call([&]() {
+		decoder->samples.clear();
+
+		for (size_t i = 0; i < samples_count; i++) {
+			decoder->samples.push_back(rfid::device::Interface::Sample(samples[i].length_us, samples[i].high != 0));
+		}
+
+		return decoder->feed(decoder->samples, tokens, capacity, count);
+	});
+}